@@ -0,0 +1,261 @@
+#include "Base64.h"
+#include "include/Declarations.h"
+
+#include <SDL3/SDL.h>
+#include <array>
+
+// SIMD names the instruction family, the vector paths also need the matching architecture.
+#if SIMD == SIMD_SSE && ( defined( __x86_64__ ) || defined( _M_X64 ) || defined( __i386__ ) || defined( _M_IX86 ) )
+#define BASE64_X86
+#include <immintrin.h>
+#elif SIMD == SIMD_NEON && ( defined( __aarch64__ ) || defined( _M_ARM64 ) )
+#define BASE64_NEON
+#include <arm_neon.h>
+#endif
+
+// GCC and Clang only emit the vector instructions of functions that ask for them, the rest of
+// the build stays at the baseline ISA. MSVC accepts the intrinsics anywhere.
+#if defined( __GNUC__ ) || defined( __clang__ )
+#define BASE64_TARGET( isa ) __attribute__( ( target( isa ) ) )
+#else
+#define BASE64_TARGET( isa )
+#endif
+
+namespace Base64 {
+
+	namespace {
+		constexpr uint8_t INVALID = 0xFF;
+
+		constexpr std::array<uint8_t, 256> DECODE_TABLE = [] {
+			std::array<uint8_t, 256> table{ };
+			table.fill( INVALID );
+			const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+			for ( uint8_t i = 0; i < 64; ++i ) {
+				table[static_cast< uint8_t >( alphabet[i] )] = i;
+			}
+			return table;
+		}( );
+
+		// Length of the encoded data without its '=' padding.
+		size_t GetPayloadLength( std::string_view encoded ) {
+			size_t length = encoded.size( );
+			while ( length > 0 && encoded[length - 1] == '=' ) {
+				--length;
+			}
+			return length;
+		}
+
+		// Decodes in[0, length) of a payload, length is its unpadded size and begin a multiple of 4.
+		bool DecodeTail( const uint8_t *in, size_t begin, size_t length, uint8_t *out ) {
+			if ( length % 4 == 1 ) {
+				return false;
+			}
+
+			size_t i = begin;
+			for ( ; i + 4 <= length; i += 4 ) {
+				const uint8_t a = DECODE_TABLE[in[i]], b = DECODE_TABLE[in[i + 1]], c = DECODE_TABLE[in[i + 2]], d = DECODE_TABLE[in[i + 3]];
+				if ( ( a | b | c | d ) & 0x80 ) {
+					return false;
+				}
+				const uint32_t bits = ( uint32_t( a ) << 18 ) | ( uint32_t( b ) << 12 ) | ( uint32_t( c ) << 6 ) | d;
+				*out++ = static_cast< uint8_t >( bits >> 16 );
+				*out++ = static_cast< uint8_t >( bits >> 8 );
+				*out++ = static_cast< uint8_t >( bits );
+			}
+
+			// A last group of 2 or 3 characters holds 1 or 2 bytes.
+			if ( i < length ) {
+				uint32_t bits = 0;
+				for ( size_t j = i; j < length; ++j ) {
+					const uint8_t value = DECODE_TABLE[in[j]];
+					if ( value & 0x80 ) {
+						return false;
+					}
+					bits = ( bits << 6 ) | value;
+				}
+				if ( length - i == 2 ) {
+					*out = static_cast< uint8_t >( bits >> 4 );
+				} else {
+					*out++ = static_cast< uint8_t >( bits >> 10 );
+					*out = static_cast< uint8_t >( bits >> 2 );
+				}
+			}
+			return true;
+		}
+
+		// The vector paths translate characters with two nibble lookups (Mula & Lemire, "Faster
+		// Base64 Encoding and Decoding using AVX2 Instructions"): a character is valid exactly when
+		// LOOKUP_LOW[low nibble] & LOOKUP_HIGH[high nibble] is 0, and adding
+		// LOOKUP_ROLL[high nibble, minus one for '/'] turns it into its 6-bit value.
+		constexpr uint8_t LOOKUP_LOW[16] = { 0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A };
+		constexpr uint8_t LOOKUP_HIGH[16] = { 0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10 };
+		constexpr int8_t LOOKUP_ROLL[16] = { 0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0 };
+
+#if defined( BASE64_X86 )
+		// Each step reads 16 characters and stores 16 bytes of which 12 are output, so it stops
+		// while the next store would still fit into the output.
+		BASE64_TARGET( "sse4.1" )
+		size_t DecodeSse( const uint8_t *in, size_t length, uint8_t *out ) {
+			const __m128i lookupLow = _mm_loadu_si128( reinterpret_cast< const __m128i * >( LOOKUP_LOW ) );
+			const __m128i lookupHigh = _mm_loadu_si128( reinterpret_cast< const __m128i * >( LOOKUP_HIGH ) );
+			const __m128i lookupRoll = _mm_loadu_si128( reinterpret_cast< const __m128i * >( LOOKUP_ROLL ) );
+			const __m128i mask2F = _mm_set1_epi8( 0x2F );
+			const __m128i pack = _mm_setr_epi8( 2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1 );
+
+			size_t i = 0;
+			for ( ; i + 24 <= length; i += 16 ) {
+				const __m128i chars = _mm_loadu_si128( reinterpret_cast< const __m128i * >( in + i ) );
+				// pshufb only looks at the low nibble and bit 7, masking with 0x2F keeps bit 7 clear.
+				const __m128i highNibbles = _mm_and_si128( _mm_srli_epi32( chars, 4 ), mask2F );
+				const __m128i lowNibbles = _mm_and_si128( chars, mask2F );
+				const __m128i high = _mm_shuffle_epi8( lookupHigh, highNibbles );
+				const __m128i low = _mm_shuffle_epi8( lookupLow, lowNibbles );
+				if ( !_mm_testz_si128( low, high ) ) {
+					break;
+				}
+				const __m128i slash = _mm_cmpeq_epi8( chars, mask2F );
+				const __m128i values = _mm_add_epi8( chars, _mm_shuffle_epi8( lookupRoll, _mm_add_epi8( slash, highNibbles ) ) );
+
+				// 4 x 6 bits -> 24 bits per dword, then the 3 bytes of each in big endian order.
+				const __m128i pairs = _mm_maddubs_epi16( values, _mm_set1_epi32( 0x01400140 ) );
+				const __m128i dwords = _mm_madd_epi16( pairs, _mm_set1_epi32( 0x00011000 ) );
+				_mm_storeu_si128( reinterpret_cast< __m128i * >( out + i / 4 * 3 ), _mm_shuffle_epi8( dwords, pack ) );
+			}
+			return i;
+		}
+
+		// Same as DecodeSse on 32 characters, the two lanes' 12 bytes are joined before the store.
+		BASE64_TARGET( "avx2" )
+		size_t DecodeAvx2( const uint8_t *in, size_t length, uint8_t *out ) {
+			const __m256i lookupLow = _mm256_broadcastsi128_si256( _mm_loadu_si128( reinterpret_cast< const __m128i * >( LOOKUP_LOW ) ) );
+			const __m256i lookupHigh = _mm256_broadcastsi128_si256( _mm_loadu_si128( reinterpret_cast< const __m128i * >( LOOKUP_HIGH ) ) );
+			const __m256i lookupRoll = _mm256_broadcastsi128_si256( _mm_loadu_si128( reinterpret_cast< const __m128i * >( LOOKUP_ROLL ) ) );
+			const __m256i mask2F = _mm256_set1_epi8( 0x2F );
+			const __m256i pack = _mm256_setr_epi8(
+				2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+				2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1 );
+			const __m256i join = _mm256_setr_epi32( 0, 1, 2, 4, 5, 6, 7, 7 );
+
+			size_t i = 0;
+			for ( ; i + 48 <= length; i += 32 ) {
+				const __m256i chars = _mm256_loadu_si256( reinterpret_cast< const __m256i * >( in + i ) );
+				const __m256i highNibbles = _mm256_and_si256( _mm256_srli_epi32( chars, 4 ), mask2F );
+				const __m256i lowNibbles = _mm256_and_si256( chars, mask2F );
+				const __m256i high = _mm256_shuffle_epi8( lookupHigh, highNibbles );
+				const __m256i low = _mm256_shuffle_epi8( lookupLow, lowNibbles );
+				if ( !_mm256_testz_si256( low, high ) ) {
+					break;
+				}
+				const __m256i slash = _mm256_cmpeq_epi8( chars, mask2F );
+				const __m256i values = _mm256_add_epi8( chars, _mm256_shuffle_epi8( lookupRoll, _mm256_add_epi8( slash, highNibbles ) ) );
+
+				const __m256i pairs = _mm256_maddubs_epi16( values, _mm256_set1_epi32( 0x01400140 ) );
+				const __m256i dwords = _mm256_madd_epi16( pairs, _mm256_set1_epi32( 0x00011000 ) );
+				const __m256i bytes = _mm256_permutevar8x32_epi32( _mm256_shuffle_epi8( dwords, pack ), join );
+				_mm256_storeu_si256( reinterpret_cast< __m256i * >( out + i / 4 * 3 ), bytes );
+			}
+			return i;
+		}
+#elif defined( BASE64_NEON )
+		// 64 characters per step, de-interleaved by vld4q so every register holds one position of
+		// 16 groups. vst3q stores exactly the 48 output bytes.
+		size_t DecodeNeon( const uint8_t *in, size_t length, uint8_t *out ) {
+			const uint8x16_t lookupLow = vld1q_u8( LOOKUP_LOW );
+			const uint8x16_t lookupHigh = vld1q_u8( LOOKUP_HIGH );
+			const uint8x16_t lookupRoll = vreinterpretq_u8_s8( vld1q_s8( LOOKUP_ROLL ) );
+			const uint8x16_t slashChar = vdupq_n_u8( '/' );
+			const uint8x16_t nibbleMask = vdupq_n_u8( 0x0F );
+
+			auto translate = [&] ( uint8x16_t chars, uint8x16_t &invalid ) {
+				const uint8x16_t highNibbles = vshrq_n_u8( chars, 4 );
+				invalid = vorrq_u8( invalid, vandq_u8( vqtbl1q_u8( lookupLow, vandq_u8( chars, nibbleMask ) ), vqtbl1q_u8( lookupHigh, highNibbles ) ) );
+				// vceqq gives 0xFF for '/', adding it subtracts one from the index.
+				const uint8x16_t roll = vqtbl1q_u8( lookupRoll, vaddq_u8( highNibbles, vceqq_u8( chars, slashChar ) ) );
+				return vaddq_u8( chars, roll );
+			};
+
+			size_t i = 0;
+			for ( ; i + 64 <= length; i += 64 ) {
+				const uint8x16x4_t chars = vld4q_u8( in + i );
+				uint8x16_t invalid = vdupq_n_u8( 0 );
+				const uint8x16_t a = translate( chars.val[0], invalid );
+				const uint8x16_t b = translate( chars.val[1], invalid );
+				const uint8x16_t c = translate( chars.val[2], invalid );
+				const uint8x16_t d = translate( chars.val[3], invalid );
+				if ( vmaxvq_u8( invalid ) != 0 ) {
+					break;
+				}
+
+				uint8x16x3_t bytes;
+				bytes.val[0] = vorrq_u8( vshlq_n_u8( a, 2 ), vshrq_n_u8( b, 4 ) );
+				bytes.val[1] = vorrq_u8( vshlq_n_u8( b, 4 ), vshrq_n_u8( c, 2 ) );
+				bytes.val[2] = vorrq_u8( vshlq_n_u8( c, 6 ), d );
+				vst3q_u8( out + i / 4 * 3, bytes );
+			}
+			return i;
+		}
+#endif
+
+		using BlockDecoder = size_t ( * )( const uint8_t *in, size_t length, uint8_t *out );
+
+		// The vector decoder of path, nullptr for the scalar path and paths this build or CPU lacks.
+		// It decodes whole blocks from the start of the payload and returns how many characters it
+		// consumed; a block with an invalid character is left to the scalar code, which rejects it.
+		BlockDecoder GetBlockDecoder( Path path ) {
+			switch ( path ) {
+#if defined( BASE64_X86 )
+			case Path::Sse41:
+				return SDL_HasSSE41( ) ? DecodeSse : nullptr;
+			case Path::Avx2:
+				return SDL_HasAVX2( ) ? DecodeAvx2 : nullptr;
+#elif defined( BASE64_NEON )
+			case Path::Neon:
+				return DecodeNeon;
+#endif
+			default:
+				return nullptr;
+			}
+		}
+
+		// The widest vector path for this CPU, nullptr if there is none.
+		BlockDecoder SelectBlockDecoder( ) {
+			for ( Path path : { Path::Avx2, Path::Sse41, Path::Neon } ) {
+				if ( BlockDecoder blockDecoder = GetBlockDecoder( path ) ) {
+					return blockDecoder;
+				}
+			}
+			return nullptr;
+		}
+
+		bool DecodeWith( BlockDecoder blockDecoder, std::string_view encoded, uint8_t *out ) {
+			const uint8_t *in = reinterpret_cast< const uint8_t * >( encoded.data( ) );
+			const size_t length = GetPayloadLength( encoded );
+			const size_t decoded = blockDecoder ? blockDecoder( in, length, out ) : 0;
+			return DecodeTail( in, decoded, length, out + decoded / 4 * 3 );
+		}
+	}
+
+	size_t GetDecodedSize( std::string_view encoded ) {
+		return GetPayloadLength( encoded ) * 3 / 4;
+	}
+
+	bool DecodeScalar( std::string_view encoded, uint8_t *out ) {
+		return DecodeTail( reinterpret_cast< const uint8_t * >( encoded.data( ) ), 0, GetPayloadLength( encoded ), out );
+	}
+
+	bool Decode( std::string_view encoded, uint8_t *out ) {
+		static const BlockDecoder blockDecoder = SelectBlockDecoder( );
+		return DecodeWith( blockDecoder, encoded, out );
+	}
+
+	bool IsSupported( Path path ) {
+		return path == Path::Scalar || GetBlockDecoder( path ) != nullptr;
+	}
+
+	bool Decode( std::string_view encoded, uint8_t *out, Path path ) {
+		if ( !IsSupported( path ) ) {
+			return false;
+		}
+		return DecodeWith( GetBlockDecoder( path ), encoded, out );
+	}
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+// Base64 decoding into caller memory. Decode picks the widest vector path the CPU supports:
+// AVX2 or SSE4.1 on x86 (SIMD_SSE), NEON on AArch64 (SIMD_NEON), see include/Declarations.h.
+// Every path decodes the same way the scalar one does, including what they reject.
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace Base64 {
+
+	// Bytes Decode writes for encoded, its '=' padding does not count.
+	size_t GetDecodedSize( std::string_view encoded );
+
+	// Decodes standard base64 (RFC 4648, '+' and '/', optional '=' padding, no whitespace) into
+	// out, which must hold GetDecodedSize( encoded ) bytes. Returns false on characters outside
+	// the alphabet or a truncated last group, out is undefined then.
+	bool Decode( std::string_view encoded, uint8_t *out );
+
+	// The portable decoder, always available. Same contract as Decode.
+	bool DecodeScalar( std::string_view encoded, uint8_t *out );
+
+	// The decoders Decode picks from.
+	enum class Path {
+		Scalar,
+		Sse41,
+		Avx2,
+		Neon,
+	};
+
+	// Whether this build and CPU can run path.
+	bool IsSupported( Path path );
+
+	// Decode on the given path instead of the widest one, for tests and benchmarks. Same contract
+	// as Decode, and false if the path is not supported here.
+	bool Decode( std::string_view encoded, uint8_t *out, Path path );
+}
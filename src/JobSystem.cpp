@@ -0,0 +1,266 @@
+#include "JobSystem.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <SDL3/SDL_assert.h>
+
+namespace {
+	// Index of the worker the current thread is, -1 for threads the job system does not own.
+	thread_local int currentWorkerIndex = -1;
+
+	// How often an idle worker looks for work again before it goes to sleep.
+	constexpr int IDLE_SPINS = 64;
+}
+
+bool JobSystem::WorkQueue::PushBack( const Job &job ) {
+	std::lock_guard<std::mutex> lock( mutex );
+	if ( count == jobs.size( ) ) {
+		return false;
+	}
+	jobs[( head + count ) % jobs.size( )] = job;
+	++count;
+	return true;
+}
+
+bool JobSystem::WorkQueue::PopBack( Job &job ) {
+	std::lock_guard<std::mutex> lock( mutex );
+	if ( count == 0 ) {
+		return false;
+	}
+	--count;
+	job = jobs[( head + count ) % jobs.size( )];
+	return true;
+}
+
+bool JobSystem::WorkQueue::PopFront( Job &job ) {
+	std::lock_guard<std::mutex> lock( mutex );
+	if ( count == 0 ) {
+		return false;
+	}
+	job = jobs[head];
+	head = ( head + 1 ) % jobs.size( );
+	--count;
+	return true;
+}
+
+void JobSystem::Init( int workerCount ) {
+	if ( IsInitialized( ) ) {
+		return;
+	}
+
+	if ( workerCount <= 0 ) {
+		workerCount = static_cast< int >( std::max( 1u, std::thread::hardware_concurrency( ) ) );
+	}
+	workerCount = std::min( workerCount, MAX_WORKERS );
+
+	m_queues.clear( );
+	for ( int i = 0; i < workerCount; ++i ) {
+		auto queue = std::make_unique<WorkQueue>( );
+		queue->jobs.resize( QUEUE_CAPACITY );
+		m_queues.push_back( std::move( queue ) );
+	}
+
+	m_running = true;
+	currentWorkerIndex = 0;
+	m_workers.resize( workerCount );
+	for ( int i = 1; i < workerCount; ++i ) {
+		m_workers[i] = std::thread( &JobSystem::WorkerMain, this, static_cast< uint32_t >( i ) );
+	}
+
+	std::cout << "Job system started with " << workerCount << " workers." << std::endl;
+}
+
+void JobSystem::Shutdown( ) {
+	if ( !IsInitialized( ) ) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock( m_wakeMutex );
+		m_running = false;
+	}
+	m_wake.notify_all( );
+
+	for ( std::thread &worker : m_workers ) {
+		if ( worker.joinable( ) ) {
+			worker.join( );
+		}
+	}
+	m_workers.clear( );
+	m_queues.clear( );
+	m_queuedJobs = 0;
+	currentWorkerIndex = -1;
+}
+
+void JobSystem::Push( const Job &job ) {
+	const int workerIndex = currentWorkerIndex;
+
+	// Workers keep their jobs local, other threads hand them to the workers in turn.
+	size_t queueIndex = 0;
+	if ( workerIndex >= 0 ) {
+		queueIndex = static_cast< size_t >( workerIndex );
+	} else {
+		static std::atomic<uint32_t> nextQueue{ 0 };
+		queueIndex = nextQueue.fetch_add( 1, std::memory_order_relaxed ) % m_queues.size( );
+	}
+
+	// Queue full: a worker runs queued jobs until its queue has room. Other threads have no
+	// worker index to run jobs under, they move on to the next queue and yield until one has room.
+	while ( !m_queues[queueIndex]->PushBack( job ) ) {
+		Job queued;
+		if ( workerIndex >= 0 && TryGetJob( static_cast< uint32_t >( workerIndex ), queued ) ) {
+			Execute( queued, static_cast< uint32_t >( workerIndex ) );
+		} else {
+			if ( workerIndex < 0 ) {
+				queueIndex = ( queueIndex + 1 ) % m_queues.size( );
+			}
+			std::this_thread::yield( );
+		}
+	}
+
+	m_queuedJobs.fetch_add( 1, std::memory_order_release );
+	{
+		// Taking the lock orders this against a worker that is about to sleep.
+		std::lock_guard<std::mutex> lock( m_wakeMutex );
+	}
+	m_wake.notify_one( );
+}
+
+void JobSystem::Submit( JobFunction function, void *data, JobCounter &counter ) {
+	counter.pending.fetch_add( 1, std::memory_order_relaxed );
+	const Job job = { function, data, 0, 1, &counter };
+	if ( !IsInitialized( ) ) {
+		Execute( job, 0 );
+		return;
+	}
+	Push( job );
+}
+
+void JobSystem::ParallelFor( JobFunction function, int count, int minRange, void *data, JobCounter &counter ) {
+	if ( count <= 0 ) {
+		return;
+	}
+	minRange = std::max( minRange, 1 );
+
+	const int workers = std::max( GetWorkerCount( ), 1 );
+	const int ranges = std::min( workers, ( count + minRange - 1 ) / minRange );
+	counter.pending.fetch_add( ranges, std::memory_order_relaxed );
+
+	const int rangeSize = count / ranges;
+	const int remainder = count % ranges;
+	int begin = 0;
+	for ( int i = 0; i < ranges; ++i ) {
+		// The first ranges take one item of the remainder each.
+		const int end = begin + rangeSize + ( i < remainder ? 1 : 0 );
+		const Job job = { function, data, begin, end, &counter };
+		if ( !IsInitialized( ) ) {
+			Execute( job, 0 );
+		} else {
+			Push( job );
+		}
+		begin = end;
+	}
+}
+
+void JobSystem::Wait( JobCounter &counter ) {
+	const int workerIndex = currentWorkerIndex;
+	while ( !counter.IsDone( ) ) {
+		Job job;
+		if ( workerIndex >= 0 && TryGetJob( static_cast< uint32_t >( workerIndex ), job ) ) {
+			Execute( job, static_cast< uint32_t >( workerIndex ) );
+		} else {
+			std::this_thread::yield( );
+		}
+	}
+}
+
+bool JobSystem::TryGetJob( uint32_t workerIndex, Job &job ) {
+	if ( m_queuedJobs.load( std::memory_order_acquire ) == 0 ) {
+		return false;
+	}
+
+	const size_t queueCount = m_queues.size( );
+	bool found = m_queues[workerIndex]->PopBack( job );
+	for ( size_t i = 1; !found && i < queueCount; ++i ) {
+		found = m_queues[( workerIndex + i ) % queueCount]->PopFront( job );
+	}
+	if ( found ) {
+		m_queuedJobs.fetch_sub( 1, std::memory_order_acq_rel );
+	}
+	return found;
+}
+
+void JobSystem::Execute( const Job &job, uint32_t workerIndex ) {
+	SP_PROFILE_SCOPE( "Job" );
+	job.function( job.begin, job.end, workerIndex, job.data );
+	job.counter->pending.fetch_sub( 1, std::memory_order_release );
+}
+
+void JobSystem::WorkerMain( uint32_t workerIndex ) {
+	currentWorkerIndex = static_cast< int >( workerIndex );
+	SP_PROFILE_THREAD( ( "Worker " + std::to_string( workerIndex ) ).c_str( ) );
+
+	int idle = 0;
+	while ( m_running.load( std::memory_order_acquire ) ) {
+		Job job;
+		if ( TryGetJob( workerIndex, job ) ) {
+			Execute( job, workerIndex );
+			idle = 0;
+			continue;
+		}
+
+		// Physics stages are queued in quick succession, look again a few times before sleeping.
+		if ( ++idle < IDLE_SPINS ) {
+			std::this_thread::yield( );
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock( m_wakeMutex );
+		m_wake.wait( lock, [this] {
+			return m_queuedJobs.load( std::memory_order_acquire ) > 0 || !m_running.load( std::memory_order_acquire );
+		} );
+		idle = 0;
+	}
+}
+
+void *JobSystem::EnqueuePhysicsTask( b2TaskCallback *task, int itemCount, int minRange, void *taskContext, void *userContext ) {
+	JobSystem *self = static_cast< JobSystem * >( userContext );
+
+	// Not worth a round trip through the queues, run it here and tell Box2D there is nothing to wait on.
+	if ( itemCount <= minRange ) {
+		task( 0, itemCount, static_cast< uint32_t >( std::max( currentWorkerIndex, 0 ) ), taskContext );
+		return nullptr;
+	}
+
+	PhysicsTask &physicsTask = self->m_physicsTasks[self->m_nextPhysicsTask.fetch_add( 1, std::memory_order_relaxed ) % MAX_PHYSICS_TASKS];
+	SDL_assert( physicsTask.counter.IsDone( ) );
+	physicsTask.task = task;
+	physicsTask.context = taskContext;
+
+	self->ParallelFor( [] ( int begin, int end, uint32_t workerIndex, void *data ) {
+		PhysicsTask *physicsTask = static_cast< PhysicsTask * >( data );
+		physicsTask->task( begin, end, workerIndex, physicsTask->context );
+	}, itemCount, minRange, &physicsTask, physicsTask.counter );
+
+	return &physicsTask;
+}
+
+void JobSystem::FinishPhysicsTask( void *userTask, void *userContext ) {
+	JobSystem *self = static_cast< JobSystem * >( userContext );
+	self->Wait( static_cast< PhysicsTask * >( userTask )->counter );
+}
+
+void JobSystem::SetupWorldDef( b2WorldDef &worldDef ) {
+	if ( GetWorkerCount( ) <= 1 ) {
+		return;
+	}
+	worldDef.workerCount = GetWorkerCount( );
+	worldDef.enqueueTask = &JobSystem::EnqueuePhysicsTask;
+	worldDef.finishTask = &JobSystem::FinishPhysicsTask;
+	worldDef.userTaskContext = this;
+}
+
+JobSystem jobSystemLocal;
+JobSystem *jobSystem = &jobSystemLocal;
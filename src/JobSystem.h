@@ -0,0 +1,132 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "box2d/types.h"
+#include <glaze/glaze.hpp>
+
+struct JobSystemConfig {
+	int workerCount = 0;				// Threads running jobs, the calling thread included. 0 picks one per core.
+
+	struct glaze {
+		using T = JobSystemConfig;
+		static constexpr auto value = glz::object(
+			"workerCount", &T::workerCount, "Number of job threads including the main thread, 0 for one per core"
+		);
+	};
+};
+
+// Work function of a job, called for the item range [begin, end).
+// workerIndex is the index of the thread running it, in [0, GetWorkerCount( )).
+using JobFunction = void ( * )( int begin, int end, uint32_t workerIndex, void *data );
+
+// Counts the jobs of a submission that have not finished yet.
+struct JobCounter {
+	std::atomic<int> pending{ 0 };
+
+	bool IsDone( ) const { return pending.load( std::memory_order_acquire ) == 0; }
+};
+
+// Engine wide work-stealing scheduler. Every worker owns a mutex-protected ring buffer of jobs:
+// it pushes and pops its own jobs at the back and steals from the front of the others when it
+// runs dry. The queues are locked, not lock-free.
+// The thread that calls Init is worker 0 and runs jobs while it waits on a counter.
+class JobSystem {
+public:
+	static constexpr int MAX_WORKERS = 64;
+	// Jobs a single queue can hold. A worker pushing to its full queue runs queued jobs until
+	// there is room, other threads wait for room in any queue.
+	static constexpr int QUEUE_CAPACITY = 1024;
+
+	JobSystem( ) = default;
+	~JobSystem( ) { Shutdown( ); }
+
+	JobSystem( const JobSystem & ) = delete;
+	JobSystem &operator=( const JobSystem & ) = delete;
+
+	// Starts workerCount - 1 threads, the caller becomes worker 0.
+	void Init( int workerCount = 0 );
+	void Shutdown( );
+	bool IsInitialized( ) const { return !m_workers.empty( ); }
+
+	int GetWorkerCount( ) const { return static_cast< int >( m_workers.size( ) ); }
+
+	// Queues a single job.
+	void Submit( JobFunction function, void *data, JobCounter &counter );
+
+	// Splits [0, count) into ranges of at least minRange items, at most one per worker, and queues them.
+	void ParallelFor( JobFunction function, int count, int minRange, void *data, JobCounter &counter );
+
+	// Runs queued jobs on the calling worker until the counter is done.
+	void Wait( JobCounter &counter );
+
+	// ParallelFor over a callable function( begin, end ) that returns once every range finished.
+	// Fits the parallelFor parameter of the quad tree bulk builds.
+	template <typename Function>
+	void ParallelForAndWait( int count, int minRange, Function &&function ) {
+		JobCounter counter;
+		void *context = const_cast< void * >( static_cast< const void * >( std::addressof( function ) ) );
+		ParallelFor( [] ( int begin, int end, uint32_t, void *data ) {
+			( *static_cast< std::remove_reference_t<Function> * >( data ) )( begin, end );
+		}, count, minRange, context, counter );
+		Wait( counter );
+	}
+
+	// Lets Box2D run its solver stages on the workers.
+	void SetupWorldDef( b2WorldDef &worldDef );
+
+private:
+	struct Job {
+		JobFunction function;
+		void *data;
+		int begin;
+		int end;
+		JobCounter *counter;
+	};
+
+	struct alignas( 64 ) WorkQueue {
+		std::mutex mutex;
+		std::vector<Job> jobs;	// ring buffer of QUEUE_CAPACITY jobs
+		size_t head = 0;		// oldest job, thieves take from here
+		size_t count = 0;
+
+		bool PushBack( const Job &job );
+		bool PopBack( Job &job );
+		bool PopFront( Job &job );
+	};
+
+	// Box2D allows only a fixed number of tasks in flight per step, they get counters from this ring.
+	static constexpr int MAX_PHYSICS_TASKS = 256;
+
+	static void *EnqueuePhysicsTask( b2TaskCallback *task, int itemCount, int minRange, void *taskContext, void *userContext );
+	static void FinishPhysicsTask( void *userTask, void *userContext );
+
+	void Push( const Job &job );
+	bool TryGetJob( uint32_t workerIndex, Job &job );
+	void Execute( const Job &job, uint32_t workerIndex );
+	void WorkerMain( uint32_t workerIndex );
+
+	std::vector<std::unique_ptr<WorkQueue>> m_queues;
+	std::vector<std::thread> m_workers;	// m_workers[0] stays empty, it stands for the main thread
+
+	std::mutex m_wakeMutex;
+	std::condition_variable m_wake;
+	std::atomic<int> m_queuedJobs{ 0 };
+	std::atomic<bool> m_running{ false };
+
+	struct PhysicsTask {
+		b2TaskCallback *task;
+		void *context;
+		JobCounter counter;
+	};
+	PhysicsTask m_physicsTasks[MAX_PHYSICS_TASKS];
+	std::atomic<uint32_t> m_nextPhysicsTask{ 0 };
+};
+
+extern JobSystem *jobSystem;
@@ -0,0 +1,190 @@
+#include "Profiler.h"
+
+#if SP_PROFILE_ENABLED
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "FileSystem.h"
+
+namespace Profiler {
+
+	namespace {
+		struct Event {
+			const char *name;
+			uint64_t begin;
+			uint64_t end;
+			uint32_t depth;
+		};
+
+		// A ring slot guarded by a sequence lock. The fields are relaxed atomics so a dump can read
+		// them while the owner overwrites the slot, the sequence tells afterwards whether it did.
+		struct Slot {
+			// 2 * ( n + 1 ) once zone n is complete in this slot, odd while the owner writes it.
+			std::atomic<uint64_t> sequence{ 0 };
+			std::atomic<const char *> name{ nullptr };
+			std::atomic<uint64_t> begin{ 0 };
+			std::atomic<uint64_t> end{ 0 };
+			std::atomic<uint32_t> depth{ 0 };
+		};
+
+		// Single producer ring: only the owning thread writes, the writer never waits.
+		// Once full, the oldest zones are overwritten.
+		struct ThreadBuffer {
+			static constexpr uint64_t CAPACITY = 1 << 15;
+
+			Slot slots[CAPACITY];
+			std::atomic<uint64_t> written{ 0 };
+			uint32_t depth = 0;
+			uint32_t threadId = 0;
+			std::string name;		// guarded by buffersMutex
+		};
+
+		// Buffers stay alive after their thread exits so a later dump still sees their zones.
+		std::mutex buffersMutex;
+		std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+
+		thread_local ThreadBuffer *threadBuffer = nullptr;
+
+		ThreadBuffer &GetThreadBuffer( ) {
+			if ( !threadBuffer ) {
+				auto buffer = std::make_unique<ThreadBuffer>( );
+				std::lock_guard<std::mutex> lock( buffersMutex );
+				buffer->threadId = static_cast< uint32_t >( buffers.size( ) + 1 );
+				threadBuffer = buffer.get( );
+				buffers.push_back( std::move( buffer ) );
+			}
+			return *threadBuffer;
+		}
+
+		// Copies the zones still in the ring, oldest first. Zones the owner overwrites while they
+		// are being copied are dropped, written is read once so every pass sees the same window.
+		void CopyEvents( const ThreadBuffer &buffer, std::vector<Event> &events ) {
+			events.clear( );
+			const uint64_t written = buffer.written.load( std::memory_order_acquire );
+			const uint64_t available = std::min( written, ThreadBuffer::CAPACITY );
+			for ( uint64_t n = written - available; n < written; ++n ) {
+				const Slot &slot = buffer.slots[n % ThreadBuffer::CAPACITY];
+				const uint64_t before = slot.sequence.load( std::memory_order_acquire );
+				const Event event = {
+					slot.name.load( std::memory_order_relaxed ),
+					slot.begin.load( std::memory_order_relaxed ),
+					slot.end.load( std::memory_order_relaxed ),
+					slot.depth.load( std::memory_order_relaxed ) };
+				std::atomic_thread_fence( std::memory_order_acquire );
+				const uint64_t after = slot.sequence.load( std::memory_order_relaxed );
+				if ( before == 2 * ( n + 1 ) && after == before ) {
+					events.push_back( event );
+				}
+			}
+		}
+
+		void AppendEscaped( std::string &out, const char *text ) {
+			for ( const char *c = text; *c; ++c ) {
+				if ( *c == '"' || *c == '\\' ) {
+					out += '\\';
+				}
+				out += *c;
+			}
+		}
+	}
+
+	uint64_t Now( ) {
+		return static_cast< uint64_t >( std::chrono::duration_cast< std::chrono::nanoseconds >(
+			std::chrono::steady_clock::now( ).time_since_epoch( ) ).count( ) );
+	}
+
+	uint64_t BeginZone( ) {
+		++GetThreadBuffer( ).depth;
+		return Now( );
+	}
+
+	void EndZone( const char *name, uint64_t begin ) {
+		const uint64_t end = Now( );
+		ThreadBuffer &buffer = GetThreadBuffer( );
+		--buffer.depth;
+
+		const uint64_t index = buffer.written.load( std::memory_order_relaxed );
+		Slot &slot = buffer.slots[index % ThreadBuffer::CAPACITY];
+		slot.sequence.store( 2 * index + 1, std::memory_order_relaxed );
+		std::atomic_thread_fence( std::memory_order_release );
+		slot.name.store( name, std::memory_order_relaxed );
+		slot.begin.store( begin, std::memory_order_relaxed );
+		slot.end.store( end, std::memory_order_relaxed );
+		slot.depth.store( buffer.depth, std::memory_order_relaxed );
+		slot.sequence.store( 2 * index + 2, std::memory_order_release );
+		buffer.written.store( index + 1, std::memory_order_release );
+	}
+
+	void SetThreadName( const char *name ) {
+		ThreadBuffer &buffer = GetThreadBuffer( );
+		std::lock_guard<std::mutex> lock( buffersMutex );
+		buffer.name = name;
+	}
+
+	bool WriteChromeTrace( const std::string &relativePath ) {
+		std::string json = "{\"traceEvents\":[\n";
+		bool first = true;
+		auto separate = [&] ( ) {
+			if ( !first ) {
+				json += ",\n";
+			}
+			first = false;
+		};
+
+		const uint64_t origin = Now( );
+		uint64_t earliest = origin;
+		size_t zoneCount = 0;
+
+		std::lock_guard<std::mutex> lock( buffersMutex );
+		// Every ring is copied once, the timestamps and the output come from the same snapshot.
+		std::vector<std::vector<Event>> snapshots( buffers.size( ) );
+		for ( size_t b = 0; b < buffers.size( ); ++b ) {
+			CopyEvents( *buffers[b], snapshots[b] );
+			for ( const Event &event : snapshots[b] ) {
+				earliest = std::min( earliest, event.begin );
+			}
+		}
+
+		for ( size_t b = 0; b < buffers.size( ); ++b ) {
+			const auto &buffer = buffers[b];
+			const std::string tid = std::to_string( buffer->threadId );
+			separate( );
+			json += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + tid + ",\"args\":{\"name\":\"";
+			if ( !buffer->name.empty( ) ) {
+				AppendEscaped( json, buffer->name.c_str( ) );
+			} else {
+				json += "Thread " + tid;
+			}
+			json += "\"}}";
+
+			for ( const Event &event : snapshots[b] ) {
+				separate( );
+				json += "{\"name\":\"";
+				AppendEscaped( json, event.name );
+				// Chrome wants microseconds.
+				json += "\",\"ph\":\"X\",\"pid\":1,\"tid\":" + tid;
+				json += ",\"ts\":" + std::to_string( ( event.begin - earliest ) / 1000.0 );
+				json += ",\"dur\":" + std::to_string( ( event.end - event.begin ) / 1000.0 );
+				json += ",\"args\":{\"depth\":" + std::to_string( event.depth ) + "}}";
+				++zoneCount;
+			}
+		}
+		json += "\n]}\n";
+
+		const std::vector<char> data( json.begin( ), json.end( ) );
+		if ( fileSystem->WriteFile( relativePath, data, "fs_savepath" ) < 0 ) {
+			std::cerr << "Error: Could not write profile trace '" << relativePath << "'." << std::endl;
+			return false;
+		}
+		std::cout << "Wrote " << zoneCount << " profile zones to '" << relativePath << "'." << std::endl;
+		return true;
+	}
+}
+
+#endif
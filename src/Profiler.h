@@ -0,0 +1,59 @@
+#pragma once
+
+// Zone profiler. Mark a scope with SP_PROFILE_SCOPE( "Name" ) or SP_PROFILE_FUNCTION( ),
+// every thread records its zones into its own ring buffer and SP_PROFILE_WRITE_TRACE
+// writes everything recorded so far as Chrome trace_event JSON (chrome://tracing, Perfetto).
+// Only Debug and RelWithDebInfo builds with SIEGEPERILOUS_PROFILER on have it, everywhere
+// else every macro compiles to nothing.
+
+#if SP_PROFILE_ENABLED
+
+#include <cstdint>
+#include <string>
+
+namespace Profiler {
+
+	// Nanoseconds on a monotonic clock.
+	uint64_t Now( );
+
+	// Opens a zone on the calling thread, returns its start time.
+	uint64_t BeginZone( );
+	// Closes the innermost zone of the calling thread and records it.
+	void EndZone( const char *name, uint64_t begin );
+
+	// Name the calling thread gets in the trace.
+	void SetThreadName( const char *name );
+
+	// Writes the zones of every thread to the save path. Returns false on failure.
+	bool WriteChromeTrace( const std::string &relativePath );
+
+	class Zone {
+	public:
+		explicit Zone( const char *name ) : m_name( name ), m_begin( BeginZone( ) ) { }
+		~Zone( ) { EndZone( m_name, m_begin ); }
+
+		Zone( const Zone & ) = delete;
+		Zone &operator=( const Zone & ) = delete;
+
+	private:
+		const char *m_name;
+		uint64_t m_begin;
+	};
+}
+
+#define SP_PROFILE_CONCAT_INNER( a, b ) a##b
+#define SP_PROFILE_CONCAT( a, b ) SP_PROFILE_CONCAT_INNER( a, b )
+
+#define SP_PROFILE_SCOPE( name ) ::Profiler::Zone SP_PROFILE_CONCAT( profileZone, __LINE__ )( name )
+#define SP_PROFILE_FUNCTION( ) SP_PROFILE_SCOPE( __func__ )
+#define SP_PROFILE_THREAD( name ) ::Profiler::SetThreadName( name )
+#define SP_PROFILE_WRITE_TRACE( path ) ::Profiler::WriteChromeTrace( path )
+
+#else
+
+#define SP_PROFILE_SCOPE( name ) ( ( void ) 0 )
+#define SP_PROFILE_FUNCTION( ) ( ( void ) 0 )
+#define SP_PROFILE_THREAD( name ) ( ( void ) 0 )
+#define SP_PROFILE_WRITE_TRACE( path ) ( ( void ) 0 )
+
+#endif
@@ -4,6 +4,13 @@
 #include <memory>
 #include <algorithm>
 #include <cmath> // For std::abs
+#include <cstdint>
+#include <cassert>
+#include <concepts>
+#include <iterator>
+#include <limits>
+#include <span>
+#include <type_traits>
 
 namespace QuadTree {
 	// Represents a 2D point
@@ -23,12 +30,165 @@ namespace QuadTree {
 				p.y <= center.y + half_dim.y );
 		}
 
+		// Whether other lies completely inside, touching the border counts as inside.
+		bool contains( const AABB &other ) const {
+			return ( other.center.x - other.half_dim.x >= center.x - half_dim.x &&
+				other.center.x + other.half_dim.x <= center.x + half_dim.x &&
+				other.center.y - other.half_dim.y >= center.y - half_dim.y &&
+				other.center.y + other.half_dim.y <= center.y + half_dim.y );
+		}
+
 		bool intersects( const AABB &other ) const {
 			return ( std::abs( center.x - other.center.x ) <= ( half_dim.x + other.half_dim.x ) ) &&
 				( std::abs( center.y - other.center.y ) <= ( half_dim.y + other.half_dim.y ) );
 		}
 	};
 
+	// The line segment from -> to, positions along it are fractions in [0, 1].
+	struct Segment {
+		Point from;
+		Point to;
+	};
+
+	// Closest item a segment hits. fraction is where the segment enters its bounds, 0 if it
+	// starts inside them.
+	template <typename T>
+	struct RayHit {
+		T value{ };
+		float fraction = 1.0f;
+		bool hit = false;
+	};
+
+	namespace detail {
+		// Calls a query visitor. Visitors returning bool stop the query by returning false,
+		// visitors returning nothing see every item.
+		template <typename Visitor, typename... Args>
+		bool visit( Visitor &visitor, const Args &...args ) {
+			if constexpr ( std::is_void_v<std::invoke_result_t<Visitor &, const Args &...>> ) {
+				visitor( args... );
+				return true;
+			} else {
+				return static_cast< bool >( visitor( args... ) );
+			}
+		}
+
+		// Slab test: whether the segment from + t * delta, t in [0, 1], touches box, and the
+		// first such t in fraction.
+		inline bool segment_entry( const Point &from, const Point &delta, const AABB &box, float &fraction ) {
+			float tMin = 0.0f;
+			float tMax = 1.0f;
+			const float origin[2] = { from.x, from.y };
+			const float direction[2] = { delta.x, delta.y };
+			const float center[2] = { box.center.x, box.center.y };
+			const float half[2] = { box.half_dim.x, box.half_dim.y };
+			for ( int axis = 0; axis < 2; ++axis ) {
+				if ( direction[axis] == 0.0f ) {
+					if ( std::abs( origin[axis] - center[axis] ) > half[axis] ) {
+						return false;
+					}
+					continue;
+				}
+				const float inverse = 1.0f / direction[axis];
+				float t1 = ( center[axis] - half[axis] - origin[axis] ) * inverse;
+				float t2 = ( center[axis] + half[axis] - origin[axis] ) * inverse;
+				if ( t1 > t2 ) {
+					std::swap( t1, t2 );
+				}
+				tMin = std::max( tMin, t1 );
+				tMax = std::min( tMax, t2 );
+				if ( tMin > tMax ) {
+					return false;
+				}
+			}
+			fraction = tMin;
+			return true;
+		}
+
+		// Squared distance from p to the closest point of box, 0 inside it.
+		inline float distance_squared( const Point &p, const AABB &box ) {
+			const float dx = std::max( std::abs( p.x - box.center.x ) - box.half_dim.x, 0.0f );
+			const float dy = std::max( std::abs( p.y - box.center.y ) - box.half_dim.y, 0.0f );
+			return dx * dx + dy * dy;
+		}
+
+		// Default filter of the batched queries, accepts every item.
+		struct AcceptAll {
+			template <typename T>
+			bool operator()( size_t, const T & ) const { return true; }
+		};
+
+		// Child boxes in Morton order: bit 0 set for the right half, bit 1 for the top half.
+		inline AABB child_boundary( const AABB &parent, int quadrant ) {
+			const float sub_width = parent.half_dim.x / 2.0f;
+			const float sub_height = parent.half_dim.y / 2.0f;
+			return AABB{
+				{ ( quadrant & 1 ) ? parent.center.x + sub_width : parent.center.x - sub_width,
+				  ( quadrant & 2 ) ? parent.center.y + sub_height : parent.center.y - sub_height },
+				{ sub_width, sub_height } };
+		}
+
+		// Entries per chunk of a parallel bulk build.
+		static constexpr size_t RADIX_CHUNK = 4096;
+
+		static constexpr auto serial_for = [] ( size_t count, const auto &fn ) {
+			fn( size_t( 0 ), count );
+		};
+
+		// Stable LSD radix sort of items by their uint32_t key member. Every pass counts digits per
+		// chunk of RADIX_CHUNK items, then scatters each chunk to its own offsets; passes where every
+		// key has the same digit are skipped. scratch and histograms are reused between sorts.
+		template <typename Item, typename ParallelFor>
+		void radix_sort( std::vector<Item> &items, std::vector<Item> &scratch, std::vector<size_t> &histograms, ParallelFor &parallelFor ) {
+			constexpr int RADIX_BITS = 8;
+			constexpr size_t RADIX_BUCKETS = size_t( 1 ) << RADIX_BITS;
+
+			const size_t count = items.size( );
+			const size_t chunkCount = ( count + RADIX_CHUNK - 1 ) / RADIX_CHUNK;
+			scratch.resize( count );
+			histograms.resize( chunkCount * RADIX_BUCKETS );
+
+			for ( int shift = 0; shift < 32; shift += RADIX_BITS ) {
+				parallelFor( chunkCount, [&] ( size_t firstChunk, size_t endChunk ) {
+					for ( size_t chunk = firstChunk; chunk < endChunk; ++chunk ) {
+						size_t *histogram = histograms.data( ) + chunk * RADIX_BUCKETS;
+						std::fill( histogram, histogram + RADIX_BUCKETS, size_t( 0 ) );
+						const size_t end = std::min( ( chunk + 1 ) * RADIX_CHUNK, count );
+						for ( size_t i = chunk * RADIX_CHUNK; i < end; ++i ) {
+							++histogram[( items[i].key >> shift ) & ( RADIX_BUCKETS - 1 )];
+						}
+					}
+				} );
+
+				// Offsets digit by digit, chunk by chunk within a digit.
+				size_t offset = 0;
+				bool uniform = false;
+				for ( size_t digit = 0; digit < RADIX_BUCKETS; ++digit ) {
+					const size_t digitBegin = offset;
+					for ( size_t chunk = 0; chunk < chunkCount; ++chunk ) {
+						const size_t digitCount = histograms[chunk * RADIX_BUCKETS + digit];
+						histograms[chunk * RADIX_BUCKETS + digit] = offset;
+						offset += digitCount;
+					}
+					uniform = uniform || offset - digitBegin == count;
+				}
+				if ( uniform ) {
+					continue;
+				}
+
+				parallelFor( chunkCount, [&] ( size_t firstChunk, size_t endChunk ) {
+					for ( size_t chunk = firstChunk; chunk < endChunk; ++chunk ) {
+						size_t *offsets = histograms.data( ) + chunk * RADIX_BUCKETS;
+						const size_t end = std::min( ( chunk + 1 ) * RADIX_CHUNK, count );
+						for ( size_t i = chunk * RADIX_CHUNK; i < end; ++i ) {
+							scratch[offsets[( items[i].key >> shift ) & ( RADIX_BUCKETS - 1 )]++] = std::move( items[i] );
+						}
+					}
+				} );
+				items.swap( scratch );
+			}
+		}
+	}
+
 	template <typename T>
 	class QuadTree {
 	private:
@@ -88,7 +248,9 @@ namespace QuadTree {
 		}
 
 	public:
+		// The query stack is sized for trees that start at level 0 or deeper.
 		QuadTree( int p_level, const AABB &p_boundary ) : level( p_level ), boundary( p_boundary ) {
+			assert( p_level >= 0 );
 			nodes[0] = nullptr;
 			nodes[1] = nullptr;
 			nodes[2] = nullptr;
@@ -128,25 +290,872 @@ namespace QuadTree {
 			}
 		}
 
+		std::vector<T> query( const AABB &range ) const {
+			std::vector<T> found;
+			query( range, std::back_inserter( found ) );
+			return found;
+		}
+
+		// Calls visitor( value ) for every object inside range, without allocating. Returns false
+		// if the visitor stopped the query early by returning false.
+		template <typename Visitor> requires std::invocable<Visitor &, const T &>
+		bool query( const AABB &range, Visitor &&visitor ) const {
+			// Every level pushes at most four children after popping its parent.
+			const QuadTree *stack[3 * MAX_LEVELS + 1];
+			int top = 0;
+			stack[top++] = this;
+			while ( top > 0 ) {
+				const QuadTree *node = stack[--top];
+				if ( !node->boundary.intersects( range ) ) {
+					continue;
+				}
+
+				for ( const auto &obj : node->objects ) {
+					if ( range.contains( obj.first ) && !detail::visit( visitor, obj.second ) ) {
+						return false;
+					}
+				}
+
+				if ( node->nodes[0] != nullptr ) {
+					// Pushed in reverse so child 0 is visited first.
+					for ( int i = 3; i >= 0; --i ) {
+						stack[top++] = node->nodes[i].get( );
+					}
+				}
+			}
+			return true;
+		}
+
+		// Writes the objects inside range to out, returns the iterator past the last one written.
+		template <std::output_iterator<const T &> OutputIt>
+		OutputIt query( const AABB &range, OutputIt out ) const {
+			query( range, [&out] ( const T &value ) { *out++ = value; } );
+			return out;
+		}
+
+		// Fills out with the objects inside range and stops once it is full.
+		// Returns the number of objects written.
+		size_t query( const AABB &range, std::span<T> out ) const {
+			size_t count = 0;
+			if ( !out.empty( ) ) {
+				query( range, [&] ( const T &value ) {
+					out[count++] = value;
+					return count < out.size( );
+				} );
+			}
+			return count;
+		}
+	};
+
+	// Same insert/query semantics as QuadTree, laid out for cache-friendly rebuilds and queries.
+	//
+	// All nodes live in one pool and refer to their four children by index. Items are kept in a
+	// single packed array sorted by their Morton key: the quadrant path from the root, one digit
+	// per level, with digit 0 for "stops here". Sorting by that key puts the items of every
+	// subtree next to each other, parent items first, so a node is just a range of the array.
+	//
+	// Inserting only appends, the tree is rebuilt with one sort on the next query. build( entries )
+	// replaces everything at once, which is the fast way to fill the tree from a level or to
+	// rebuild it for all moving entities every frame.
+	template <typename T>
+	class LinearQuadTree {
+	public:
+		static constexpr int MAX_OBJECTS = 4;
+		static constexpr int MAX_LEVELS = 8;
+
+		LinearQuadTree( int p_level, const AABB &p_boundary ) : level( p_level ), boundary( p_boundary ) { }
+
+		void insert( const Point &p, const T &value ) {
+			if ( !boundary.contains( p ) ) {
+				return;
+			}
+			items.push_back( { p, value, 0 } );
+			dirty = true;
+		}
+
+		// Drops every item, the pools keep their memory for the next fill.
+		void clear( ) {
+			items.clear( );
+			nodes.clear( );
+			dirty = true;
+		}
+
+		void reserve( size_t count ) { items.reserve( count ); }
+		size_t size( ) const { return items.size( ); }
+
+		// Sorts the items and rebuilds the nodes. Queries do this themselves when needed.
+		void build( ) {
+			for ( Item &item : items ) {
+				item.key = morton_key( item.p );
+			}
+			detail::radix_sort( items, scratch, histograms, detail::serial_for );
+			build_nodes( );
+		}
+
+		// Replaces the contents with entries, skipping those outside the boundary like insert does.
+		// Computes the Morton keys, radix sorts the items by them and emits the nodes in a single
+		// top-down pass: O(n) for the sort and no reshuffling on splits.
+		//
+		// The keys and the sort passes are split into chunks of RADIX_CHUNK entries. parallelFor( count, fn )
+		// has to call fn( begin, end ) for ranges covering [0, count), from any threads, and
+		// return once all of them finished.
+		template <typename ParallelFor>
+		void build( std::span<const std::pair<Point, T>> entries, ParallelFor &&parallelFor ) {
+			items.resize( entries.size( ) );
+			const size_t chunkCount = ( entries.size( ) + RADIX_CHUNK - 1 ) / RADIX_CHUNK;
+			parallelFor( chunkCount, [&] ( size_t firstChunk, size_t endChunk ) {
+				const size_t end = std::min( endChunk * RADIX_CHUNK, entries.size( ) );
+				for ( size_t i = firstChunk * RADIX_CHUNK; i < end; ++i ) {
+					const Point &p = entries[i].first;
+					items[i] = { p, entries[i].second, boundary.contains( p ) ? morton_key( p ) : OUTSIDE_KEY };
+				}
+			} );
+			detail::radix_sort( items, scratch, histograms, parallelFor );
+
+			// Entries outside the boundary sorted to the end.
+			const auto outside = std::partition_point( items.begin( ), items.end( ), [] ( const Item &item ) {
+				return item.key != OUTSIDE_KEY;
+			} );
+			items.erase( outside, items.end( ) );
+			build_nodes( );
+		}
+
+		void build( std::span<const std::pair<Point, T>> entries ) {
+			build( entries, detail::serial_for );
+		}
+
 		std::vector<T> query( const AABB &range ) {
 			std::vector<T> found;
-			if ( !boundary.intersects( range ) ) {
-				return found;
+			query( range, std::back_inserter( found ) );
+			return found;
+		}
+
+		// Calls visitor( value ) for every item inside range, without allocating. Returns false
+		// if the visitor stopped the query early by returning false.
+		template <typename Visitor> requires std::invocable<Visitor &, const T &>
+		bool query( const AABB &range, Visitor &&visitor ) {
+			if ( dirty ) {
+				build( );
 			}
 
-			for ( const auto &obj : objects ) {
-				if ( range.contains( obj.first ) ) {
-					found.push_back( obj.second );
+			struct Entry {
+				uint32_t node;
+				AABB box;
+			};
+			// The tree is at most MAX_LEVELS deep and every level adds at most three entries.
+			Entry stack[3 * MAX_LEVELS + 1];
+			int top = 0;
+			stack[top++] = { 0, boundary };
+			while ( top > 0 ) {
+				const Entry entry = stack[--top];
+				if ( !entry.box.intersects( range ) ) {
+					continue;
+				}
+				const Node &node = nodes[entry.node];
+				const AABB &box = entry.box;
+
+				// Fully covered, the whole subtree is one run of the item array.
+				if ( range.contains( box ) ) {
+					for ( uint32_t i = node.firstItem; i < node.subtreeEnd; ++i ) {
+						if ( !detail::visit( visitor, items[i].value ) ) {
+							return false;
+						}
+					}
+					continue;
+				}
+
+				for ( uint32_t i = node.firstItem; i < node.firstItem + node.itemCount; ++i ) {
+					if ( range.contains( items[i].p ) && !detail::visit( visitor, items[i].value ) ) {
+						return false;
+					}
+				}
+				if ( node.firstChild != 0 ) {
+					// Pushed in reverse so the items come out in array order.
+					for ( int quadrant = 3; quadrant >= 0; --quadrant ) {
+						stack[top++] = { node.firstChild + quadrant, detail::child_boundary( box, quadrant ) };
+					}
 				}
 			}
+			return true;
+		}
 
-			if ( nodes[0] != nullptr ) {
-				for ( int i = 0; i < 4; ++i ) {
-					auto child_found = nodes[i]->query( range );
-					found.insert( found.end( ), child_found.begin( ), child_found.end( ) );
+		// Writes the items inside range to out, returns the iterator past the last one written.
+		template <std::output_iterator<const T &> OutputIt>
+		OutputIt query( const AABB &range, OutputIt out ) {
+			query( range, [&out] ( const T &value ) { *out++ = value; } );
+			return out;
+		}
+
+		// Fills out with the items inside range and stops once it is full.
+		// Returns the number of items written.
+		size_t query( const AABB &range, std::span<T> out ) {
+			size_t count = 0;
+			if ( !out.empty( ) ) {
+				query( range, [&] ( const T &value ) {
+					out[count++] = value;
+					return count < out.size( );
+				} );
+			}
+			return count;
+		}
+
+		// Entries per chunk of a parallel build.
+		static constexpr size_t RADIX_CHUNK = detail::RADIX_CHUNK;
+
+	private:
+		// One 3 bit digit per level below the root.
+		static constexpr int KEY_BITS = 3;
+		// Keys use KEY_BITS * MAX_LEVELS = 24 bits, entries outside the boundary sort after all of them.
+		static constexpr uint32_t OUTSIDE_KEY = ~0u;
+
+		struct Item {
+			Point p;
+			T value;
+			uint32_t key;
+		};
+
+		struct Node {
+			uint32_t firstChild = 0;	// the four children are nodes[firstChild..firstChild+3], 0 for leaves
+			uint32_t firstItem = 0;		// items of the node itself are [firstItem, firstItem + itemCount)
+			uint32_t itemCount = 0;
+			uint32_t subtreeEnd = 0;	// items of the whole subtree are [firstItem, subtreeEnd)
+		};
+
+		// Quadrant of p in the box, -1 if it lies on a midpoint and stays in the parent.
+		static int get_quadrant( const AABB &box, const Point &p ) {
+			if ( p.x == box.center.x || p.y == box.center.y ) {
+				return -1;
+			}
+			return ( p.x > box.center.x ? 1 : 0 ) | ( p.y > box.center.y ? 2 : 0 );
+		}
+
+		void build_nodes( ) {
+			nodes.clear( );
+			nodes.push_back( { } );
+			build_node( 0, 0, static_cast< uint32_t >( items.size( ) ), level, boundary );
+			dirty = false;
+		}
+
+		uint32_t morton_key( const Point &p ) const {
+			uint32_t key = 0;
+			AABB box = boundary;
+			for ( int l = level; l < MAX_LEVELS && l - level < MAX_LEVELS; ++l ) {
+				const int quadrant = get_quadrant( box, p );
+				if ( quadrant < 0 ) {
+					break;
 				}
+				key |= static_cast< uint32_t >( quadrant + 1 ) << key_shift( l );
+				box = detail::child_boundary( box, quadrant );
+			}
+			return key;
+		}
+
+		int key_shift( int l ) const {
+			return KEY_BITS * ( MAX_LEVELS - 1 - ( l - level ) );
+		}
+
+		// Splits exactly when QuadTree would: more than MAX_OBJECTS items and depth left.
+		void build_node( uint32_t nodeIndex, uint32_t first, uint32_t end, int l, const AABB &box ) {
+			nodes[nodeIndex].firstItem = first;
+			nodes[nodeIndex].subtreeEnd = end;
+			if ( end - first <= MAX_OBJECTS || l >= MAX_LEVELS || l - level >= MAX_LEVELS ) {
+				nodes[nodeIndex].itemCount = end - first;
+				return;
+			}
+
+			// Within the range every item shares the digits above this level, so the digits of
+			// this level are sorted and each child's items are a sub-range.
+			const int shift = key_shift( l );
+			auto digit_end = [&] ( uint32_t from, uint32_t digit ) {
+				auto it = std::partition_point( items.begin( ) + from, items.begin( ) + end, [&] ( const Item &item ) {
+					return ( ( item.key >> shift ) & 7u ) <= digit;
+				} );
+				return static_cast< uint32_t >( it - items.begin( ) );
+			};
+
+			uint32_t childFirst = digit_end( first, 0 );
+			nodes[nodeIndex].itemCount = childFirst - first;
+
+			const uint32_t firstChild = static_cast< uint32_t >( nodes.size( ) );
+			nodes[nodeIndex].firstChild = firstChild;
+			nodes.resize( nodes.size( ) + 4 );
+			for ( int quadrant = 0; quadrant < 4; ++quadrant ) {
+				const uint32_t childEnd = digit_end( childFirst, static_cast< uint32_t >( quadrant + 1 ) );
+				build_node( firstChild + quadrant, childFirst, childEnd, l + 1, detail::child_boundary( box, quadrant ) );
+				childFirst = childEnd;
 			}
+		}
+
+		int level;
+		AABB boundary;
+		std::vector<Item> items;
+		std::vector<Node> nodes;
+		// Reused by every sort.
+		std::vector<Item> scratch;
+		std::vector<size_t> histograms;
+		bool dirty = true;
+	};
+
+	// QuadTree for moving objects with extent. Every item is an AABB and lives in the deepest
+	// node that contains it completely; items crossing a midpoint stay in the parent, like points
+	// on a midpoint do in QuadTree. Items reaching outside the boundary stay in the root.
+	//
+	// insert returns a handle that stays valid until the item is removed. Nodes split once a leaf
+	// holds more than MAX_OBJECTS items and merge back when their subtree drops below MAX_OBJECTS.
+	// Nodes and items live in pools and are linked by index, so none of this allocates once the
+	// pools have grown.
+	template <typename T>
+	class DynamicQuadTree {
+	public:
+		using value_type = T;
+		using Handle = uint32_t;
+		static constexpr Handle INVALID_HANDLE = ~0u;
+
+		static constexpr int MAX_OBJECTS = 4;
+		static constexpr int MAX_LEVELS = 8;
+
+		DynamicQuadTree( int p_level, const AABB &p_boundary ) : level( p_level ) {
+			nodes.push_back( { p_boundary, NONE, 0, NONE, 0, NONE, p_level } );
+		}
+
+		Handle insert( const AABB &bounds, const T &value ) {
+			Handle handle;
+			if ( freeItem != NONE ) {
+				handle = freeItem;
+				freeItem = items[handle].next;
+			} else {
+				handle = static_cast< Handle >( items.size( ) );
+				items.emplace_back( );
+			}
+			items[handle].bounds = bounds;
+			items[handle].value = value;
+			++count;
+
+			++nodes[0].subtreeCount;
+			place( handle, 0 );
+			return handle;
+		}
+
+		void remove( Handle handle ) {
+			assert( handle < items.size( ) && items[handle].node != NONE && "Removing a handle that is not alive." );
+			const uint32_t node = items[handle].node;
+			unlink( handle );
+			for ( uint32_t n = node; n != NONE; n = nodes[n].parent ) {
+				--nodes[n].subtreeCount;
+			}
+
+			items[handle].node = NONE;
+			items[handle].value = T( );
+			items[handle].next = freeItem;
+			freeItem = handle;
+			--count;
+
+			merge_upwards( node );
+		}
+
+		// Moves an item. It only changes nodes if the new bounds leave its node's box or now fit
+		// into one of its children, otherwise only the bounds are stored.
+		void update( Handle handle, const AABB &newBounds ) {
+			assert( handle < items.size( ) && items[handle].node != NONE && "Updating a handle that is not alive." );
+			Item &item = items[handle];
+			const uint32_t node = item.node;
+			item.bounds = newBounds;
+
+			const bool fitsNode = node == 0 || nodes[node].box.contains( newBounds );
+			if ( fitsNode && ( nodes[node].firstChild == NONE || fit_quadrant( nodes[node].box, newBounds ) < 0 ) ) {
+				return;
+			}
+
+			// Climb to the first node that still holds the item, only the part below it changes.
+			uint32_t ancestor = node;
+			while ( ancestor != 0 && !nodes[ancestor].box.contains( newBounds ) ) {
+				ancestor = nodes[ancestor].parent;
+			}
+			unlink( handle );
+			for ( uint32_t n = node; n != ancestor; n = nodes[n].parent ) {
+				--nodes[n].subtreeCount;
+			}
+			place( handle, ancestor );
+			merge_upwards( node );
+		}
+
+		const T &get( Handle handle ) const { return items[handle].value; }
+		const AABB &get_bounds( Handle handle ) const { return items[handle].bounds; }
+		size_t size( ) const { return count; }
+
+		// Removes every item, handles become invalid. The pools keep their memory.
+		void clear( ) {
+			const AABB boundary = nodes[0].box;
+			nodes.clear( );
+			nodes.push_back( { boundary, NONE, 0, NONE, 0, NONE, level } );
+			freeBlocks.clear( );
+			items.clear( );
+			freeItem = NONE;
+			count = 0;
+		}
+
+		// Replaces the contents with entries, entry i gets handle i. Every item's path down the
+		// tree is packed into a key like LinearQuadTree's Morton keys, the items are radix sorted
+		// by it and the nodes are emitted top-down from the sorted runs. A node splits exactly
+		// when inserting the entries one by one would have split it, so the tree has the same
+		// shape without moving items around on every split.
+		//
+		// The keys and the sort run in chunks of detail::RADIX_CHUNK entries through parallelFor,
+		// which has the same contract as in LinearQuadTree::build.
+		template <typename ParallelFor>
+		void build( std::span<const std::pair<AABB, T>> entries, ParallelFor &&parallelFor ) {
+			clear( );
+			items.resize( entries.size( ) );
+			buildEntries.resize( entries.size( ) );
+			const size_t chunkCount = ( entries.size( ) + detail::RADIX_CHUNK - 1 ) / detail::RADIX_CHUNK;
+			parallelFor( chunkCount, [&] ( size_t firstChunk, size_t endChunk ) {
+				const size_t end = std::min( endChunk * detail::RADIX_CHUNK, entries.size( ) );
+				for ( size_t i = firstChunk * detail::RADIX_CHUNK; i < end; ++i ) {
+					items[i].bounds = entries[i].first;
+					items[i].value = entries[i].second;
+					buildEntries[i] = { path_key( entries[i].first ), static_cast< Handle >( i ) };
+				}
+			} );
+			detail::radix_sort( buildEntries, buildScratch, histograms, parallelFor );
+
+			count = entries.size( );
+			build_node( 0, 0, static_cast< uint32_t >( buildEntries.size( ) ) );
+		}
+
+		void build( std::span<const std::pair<AABB, T>> entries ) {
+			build( entries, detail::serial_for );
+		}
+
+		std::vector<T> query( const AABB &range ) const {
+			std::vector<T> found;
+			query( range, std::back_inserter( found ) );
 			return found;
 		}
+
+		// Calls visitor( value ) for every item whose bounds intersect range, without allocating.
+		// Returns false if the visitor stopped the query early by returning false.
+		template <typename Visitor> requires std::invocable<Visitor &, const T &>
+		bool query( const AABB &range, Visitor &&visitor ) const {
+			// The tree is at most MAX_LEVELS deep and every level adds at most three entries.
+			uint32_t stack[3 * MAX_LEVELS + 1];
+			int top = 0;
+			stack[top++] = 0;
+			while ( top > 0 ) {
+				const Node &node = nodes[stack[--top]];
+				// Items of the root may reach outside its box, it is always searched.
+				if ( &node != &nodes[0] && !node.box.intersects( range ) ) {
+					continue;
+				}
+
+				for ( uint32_t i = node.firstItem; i != NONE; i = items[i].next ) {
+					if ( items[i].bounds.intersects( range ) && !detail::visit( visitor, items[i].value ) ) {
+						return false;
+					}
+				}
+				if ( node.firstChild != NONE ) {
+					for ( int quadrant = 3; quadrant >= 0; --quadrant ) {
+						stack[top++] = node.firstChild + quadrant;
+					}
+				}
+			}
+			return true;
+		}
+
+		// Writes the items intersecting range to out, returns the iterator past the last one written.
+		template <std::output_iterator<const T &> OutputIt>
+		OutputIt query( const AABB &range, OutputIt out ) const {
+			query( range, [&out] ( const T &value ) { *out++ = value; } );
+			return out;
+		}
+
+		// Fills out with the items intersecting range and stops once it is full.
+		// Returns the number of items written.
+		size_t query( const AABB &range, std::span<T> out ) const {
+			size_t written = 0;
+			if ( !out.empty( ) ) {
+				query( range, [&] ( const T &value ) {
+					out[written++] = value;
+					return written < out.size( );
+				} );
+			}
+			return written;
+		}
+
+		// Calls visitor( value, fraction ) for every item whose bounds the segment touches, front to
+		// back: fraction is where the segment enters the item's bounds and never decreases from one
+		// call to the next. Returning false from the visitor stops the cast, so the first call is
+		// the closest hit and line-of-sight checks can stop at the first blocker.
+		// Returns false if the visitor stopped the cast.
+		template <typename Visitor> requires std::invocable<Visitor &, const T &, float>
+		bool raycast( const Point &from, const Point &to, Visitor &&visitor ) const {
+			std::vector<SearchEntry> heap;
+			return raycast( from, to, visitor, heap );
+		}
+
+		// Calls visitor( value, distance ) for the items by increasing distance from point to their
+		// bounds, 0 for items containing it, up to maxDistance. Returning false from the visitor
+		// stops the search. Returns false if the visitor stopped it.
+		template <typename Visitor> requires std::invocable<Visitor &, const T &, float>
+		bool nearest( const Point &point, Visitor &&visitor, float maxDistance = std::numeric_limits<float>::infinity( ) ) const {
+			std::vector<SearchEntry> heap;
+			return nearest( point, visitor, maxDistance, heap );
+		}
+
+		// Fills out with the out.size( ) items closest to point, nearest first.
+		// Returns the number of items written, fewer if the tree runs out within maxDistance.
+		size_t nearest( const Point &point, std::span<T> out, float maxDistance = std::numeric_limits<float>::infinity( ) ) const {
+			std::vector<SearchEntry> heap;
+			detail::AcceptAll acceptAll;
+			return nearest( point, out, maxDistance, acceptAll, 0, heap );
+		}
+
+		// Batched raycast: hits[i] becomes the closest item segments[i] touches for which
+		// filter( i, value ) is true, e.g. to skip the entity casting the ray.
+		// The single queries allocate their search heap, a batch shares one.
+		template <typename Filter = detail::AcceptAll>
+		void raycast( std::span<const Segment> segments, std::span<RayHit<T>> hits, Filter &&filter = { } ) const {
+			assert( hits.size( ) >= segments.size( ) );
+			std::vector<SearchEntry> heap;
+			for ( size_t i = 0; i < segments.size( ); ++i ) {
+				RayHit<T> &hit = hits[i];
+				hit = RayHit<T>( );
+				auto closest = [&] ( const T &value, float fraction ) {
+					if ( !filter( i, value ) ) {
+						return true;
+					}
+					hit = { value, fraction, true };
+					return false;
+				};
+				raycast( segments[i].from, segments[i].to, closest, heap );
+			}
+		}
+
+		// Batched nearest: the k nearest items of points[i] accepted by filter( i, value ) go to
+		// out[i * k, i * k + counts[i]), nearest first.
+		template <typename Filter = detail::AcceptAll>
+		void nearest( std::span<const Point> points, size_t k, std::span<T> out, std::span<size_t> counts,
+			float maxDistance = std::numeric_limits<float>::infinity( ), Filter &&filter = { } ) const {
+			assert( out.size( ) >= points.size( ) * k && counts.size( ) >= points.size( ) );
+			std::vector<SearchEntry> heap;
+			for ( size_t i = 0; i < points.size( ); ++i ) {
+				counts[i] = nearest( points[i], out.subspan( i * k, k ), maxDistance, filter, i, heap );
+			}
+		}
+
+	private:
+		static constexpr uint32_t NONE = ~0u;
+
+		// A node or an item waiting in the best-first search, key is its distance or ray fraction.
+		struct SearchEntry {
+			float key;
+			uint32_t index;
+			bool item;
+		};
+
+		// Pops nodes and items by increasing key, so an item comes out only once nothing left in
+		// the heap can be closer. key( bounds, value ) returns false for bounds to skip.
+		template <typename KeyFunction, typename Visitor>
+		bool best_first( std::vector<SearchEntry> &heap, KeyFunction &&key, Visitor &&visitor ) const {
+			// Min-heap, items first on equal keys so they are reported before more nodes are opened.
+			auto farther = [] ( const SearchEntry &a, const SearchEntry &b ) {
+				if ( a.key != b.key ) {
+					return a.key > b.key;
+				}
+				if ( a.item != b.item ) {
+					return !a.item;
+				}
+				return a.index > b.index;
+			};
+			auto push = [&] ( float value, uint32_t index, bool item ) {
+				heap.push_back( { value, index, item } );
+				std::push_heap( heap.begin( ), heap.end( ), farther );
+			};
+
+			heap.clear( );
+			// Items of the root may reach outside its box, it is always searched.
+			heap.push_back( { 0.0f, 0, false } );
+			while ( !heap.empty( ) ) {
+				std::pop_heap( heap.begin( ), heap.end( ), farther );
+				const SearchEntry entry = heap.back( );
+				heap.pop_back( );
+				if ( entry.item ) {
+					if ( !visitor( items[entry.index].value, entry.key ) ) {
+						return false;
+					}
+					continue;
+				}
+
+				const Node &node = nodes[entry.index];
+				float value;
+				for ( uint32_t i = node.firstItem; i != NONE; i = items[i].next ) {
+					if ( key( items[i].bounds, value ) ) {
+						push( value, i, true );
+					}
+				}
+				if ( node.firstChild != NONE ) {
+					for ( uint32_t child = node.firstChild; child < node.firstChild + 4; ++child ) {
+						if ( nodes[child].subtreeCount > 0 && key( nodes[child].box, value ) ) {
+							push( value, child, false );
+						}
+					}
+				}
+			}
+			return true;
+		}
+
+		template <typename Visitor>
+		bool raycast( const Point &from, const Point &to, Visitor &visitor, std::vector<SearchEntry> &heap ) const {
+			const Point delta = { to.x - from.x, to.y - from.y };
+			return best_first( heap,
+				[&] ( const AABB &bounds, float &fraction ) { return detail::segment_entry( from, delta, bounds, fraction ); },
+				[&] ( const T &value, float fraction ) { return detail::visit( visitor, value, fraction ); } );
+		}
+
+		// Searches by squared distance and reports the distance.
+		template <typename Visitor>
+		bool nearest( const Point &point, Visitor &visitor, float maxDistance, std::vector<SearchEntry> &heap ) const {
+			const float maxDistanceSquared = maxDistance * maxDistance;
+			return best_first( heap,
+				[&] ( const AABB &bounds, float &distanceSquared ) {
+					distanceSquared = detail::distance_squared( point, bounds );
+					return distanceSquared <= maxDistanceSquared;
+				},
+				[&] ( const T &value, float distanceSquared ) { return detail::visit( visitor, value, std::sqrt( distanceSquared ) ); } );
+		}
+
+		template <typename Filter>
+		size_t nearest( const Point &point, std::span<T> out, float maxDistance, Filter &filter, size_t query, std::vector<SearchEntry> &heap ) const {
+			size_t written = 0;
+			if ( !out.empty( ) ) {
+				auto collect = [&] ( const T &value, float ) {
+					if ( filter( query, value ) ) {
+						out[written++] = value;
+					}
+					return written < out.size( );
+				};
+				nearest( point, collect, maxDistance, heap );
+			}
+			return written;
+		}
+
+		struct Item {
+			AABB bounds{ };
+			T value{ };
+			uint32_t node = NONE;		// NONE while the slot is free
+			uint32_t prev = NONE;		// neighbours in the node's item list
+			uint32_t next = NONE;		// also links the free slots
+		};
+
+		// An item of a bulk build, sorted by the path of nodes it descends through.
+		struct BuildEntry {
+			uint32_t key;
+			Handle handle;
+		};
+
+		struct Node {
+			AABB box;
+			uint32_t parent;
+			uint32_t subtreeCount;		// items in this node and all its descendants
+			uint32_t firstChild;		// the four children are nodes[firstChild..firstChild+3], NONE for leaves
+			uint32_t itemCount;
+			uint32_t firstItem;
+			int level;
+		};
+
+		// Quadrant whose child box contains bounds, -1 if bounds cross or touch a midpoint or
+		// reach outside the box.
+		static int fit_quadrant( const AABB &box, const AABB &bounds ) {
+			if ( !box.contains( bounds ) ) {
+				return -1;
+			}
+			int quadrant = 0;
+			if ( bounds.center.x - bounds.half_dim.x > box.center.x ) {
+				quadrant |= 1;
+			} else if ( !( bounds.center.x + bounds.half_dim.x < box.center.x ) ) {
+				return -1;
+			}
+			if ( bounds.center.y - bounds.half_dim.y > box.center.y ) {
+				quadrant |= 2;
+			} else if ( !( bounds.center.y + bounds.half_dim.y < box.center.y ) ) {
+				return -1;
+			}
+			return quadrant;
+		}
+
+		void link( Handle handle, uint32_t node ) {
+			Item &item = items[handle];
+			item.node = node;
+			item.prev = NONE;
+			item.next = nodes[node].firstItem;
+			if ( item.next != NONE ) {
+				items[item.next].prev = handle;
+			}
+			nodes[node].firstItem = handle;
+			++nodes[node].itemCount;
+		}
+
+		void unlink( Handle handle ) {
+			Item &item = items[handle];
+			if ( item.prev != NONE ) {
+				items[item.prev].next = item.next;
+			} else {
+				nodes[item.node].firstItem = item.next;
+			}
+			if ( item.next != NONE ) {
+				items[item.next].prev = item.prev;
+			}
+			--nodes[item.node].itemCount;
+		}
+
+		bool can_split( uint32_t node ) const {
+			return nodes[node].level < MAX_LEVELS && nodes[node].level - level < MAX_LEVELS;
+		}
+
+		// One 3 bit digit per level that can split: 0 if bounds stay in the node of that level,
+		// quadrant + 1 if they fit into a child.
+		int key_shift( int l ) const {
+			return 3 * ( MAX_LEVELS - 1 - ( l - level ) );
+		}
+
+		uint32_t path_key( const AABB &bounds ) const {
+			uint32_t key = 0;
+			AABB box = nodes[0].box;
+			for ( int l = level; l < MAX_LEVELS && l - level < MAX_LEVELS; ++l ) {
+				const int quadrant = fit_quadrant( box, bounds );
+				if ( quadrant < 0 ) {
+					break;
+				}
+				key |= static_cast< uint32_t >( quadrant + 1 ) << key_shift( l );
+				box = detail::child_boundary( box, quadrant );
+			}
+			return key;
+		}
+
+		// Emits node for the sorted run [first, end) of buildEntries. Every key in the run shares
+		// the digits above the node's level, so its own items come first and each child's are a
+		// sub-range. Leaves keep the whole run, like a leaf that never reached MAX_OBJECTS + 1.
+		void build_node( uint32_t node, uint32_t first, uint32_t end ) {
+			nodes[node].subtreeCount = end - first;
+			uint32_t ownEnd = end;
+			if ( end - first > MAX_OBJECTS && can_split( node ) ) {
+				const int shift = key_shift( nodes[node].level );
+				auto digit_end = [&] ( uint32_t from, uint32_t digit ) {
+					auto it = std::partition_point( buildEntries.begin( ) + from, buildEntries.begin( ) + end, [&] ( const BuildEntry &entry ) {
+						return ( ( entry.key >> shift ) & 7u ) <= digit;
+					} );
+					return static_cast< uint32_t >( it - buildEntries.begin( ) );
+				};
+				ownEnd = digit_end( first, 0 );
+
+				const AABB box = nodes[node].box;
+				const int childLevel = nodes[node].level + 1;
+				const uint32_t firstChild = static_cast< uint32_t >( nodes.size( ) );
+				nodes[node].firstChild = firstChild;
+				nodes.resize( nodes.size( ) + 4 );
+				uint32_t childFirst = ownEnd;
+				for ( int quadrant = 0; quadrant < 4; ++quadrant ) {
+					nodes[firstChild + quadrant] = { detail::child_boundary( box, quadrant ), node, 0, NONE, 0, NONE, childLevel };
+					const uint32_t childEnd = digit_end( childFirst, static_cast< uint32_t >( quadrant + 1 ) );
+					build_node( firstChild + quadrant, childFirst, childEnd );
+					childFirst = childEnd;
+				}
+			}
+			// Linked back to front, link prepends, so the node lists keep the sorted order.
+			for ( uint32_t i = ownEnd; i > first; --i ) {
+				link( buildEntries[i - 1].handle, node );
+			}
+		}
+
+		// Moves an unlinked item down from node, which already counts it, and splits the leaf it ends in.
+		void place( Handle handle, uint32_t node ) {
+			const AABB &bounds = items[handle].bounds;
+			while ( nodes[node].firstChild != NONE ) {
+				const int quadrant = fit_quadrant( nodes[node].box, bounds );
+				if ( quadrant < 0 ) {
+					break;
+				}
+				node = nodes[node].firstChild + quadrant;
+				++nodes[node].subtreeCount;
+			}
+			link( handle, node );
+
+			if ( nodes[node].firstChild == NONE && nodes[node].itemCount > MAX_OBJECTS && can_split( node ) ) {
+				split( node );
+			}
+		}
+
+		void split( uint32_t node ) {
+			uint32_t firstChild;
+			if ( !freeBlocks.empty( ) ) {
+				firstChild = freeBlocks.back( );
+				freeBlocks.pop_back( );
+			} else {
+				firstChild = static_cast< uint32_t >( nodes.size( ) );
+				nodes.resize( nodes.size( ) + 4 );
+			}
+			for ( int quadrant = 0; quadrant < 4; ++quadrant ) {
+				nodes[firstChild + quadrant] = { detail::child_boundary( nodes[node].box, quadrant ), node, 0, NONE, 0, NONE, nodes[node].level + 1 };
+			}
+			nodes[node].firstChild = firstChild;
+
+			for ( uint32_t i = nodes[node].firstItem; i != NONE; ) {
+				const uint32_t next = items[i].next;
+				const int quadrant = fit_quadrant( nodes[node].box, items[i].bounds );
+				if ( quadrant >= 0 ) {
+					unlink( i );
+					link( i, firstChild + quadrant );
+					++nodes[firstChild + quadrant].subtreeCount;
+				}
+				i = next;
+			}
+
+			for ( int quadrant = 0; quadrant < 4; ++quadrant ) {
+				const uint32_t child = firstChild + quadrant;
+				if ( nodes[child].itemCount > MAX_OBJECTS && can_split( child ) ) {
+					split( child );
+				}
+			}
+		}
+
+		// Collapses every ancestor of node, node included, whose subtree fell below MAX_OBJECTS.
+		void merge_upwards( uint32_t node ) {
+			for ( uint32_t n = node; n != NONE; n = nodes[n].parent ) {
+				if ( nodes[n].firstChild != NONE && nodes[n].subtreeCount < MAX_OBJECTS ) {
+					collapse( n, n );
+				}
+			}
+		}
+
+		// Moves the items of node's descendants into target and returns their node blocks to the pool.
+		void collapse( uint32_t node, uint32_t target ) {
+			const uint32_t firstChild = nodes[node].firstChild;
+			if ( firstChild == NONE ) {
+				return;
+			}
+			for ( int quadrant = 0; quadrant < 4; ++quadrant ) {
+				const uint32_t child = firstChild + quadrant;
+				collapse( child, target );
+				for ( uint32_t i = nodes[child].firstItem; i != NONE; ) {
+					const uint32_t next = items[i].next;
+					unlink( i );
+					link( i, target );
+					i = next;
+				}
+			}
+			nodes[node].firstChild = NONE;
+			freeBlocks.push_back( firstChild );
+		}
+
+		int level;
+		std::vector<Node> nodes;
+		// First nodes of child blocks that were merged away, reused by the next split.
+		std::vector<uint32_t> freeBlocks;
+		std::vector<Item> items;
+		uint32_t freeItem = NONE;
+		size_t count = 0;
+		// Reused by every bulk build.
+		std::vector<BuildEntry> buildEntries;
+		std::vector<BuildEntry> buildScratch;
+		std::vector<size_t> histograms;
 	};
-}
\ No newline at end of file
+}
@@ -0,0 +1,151 @@
+#include "SpatialBenchmark.h"
+
+#include <SDL3/SDL.h>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace SiegePerilous {
+
+	namespace {
+		// Queries per frame the size of a 1080p view, the rest are neighbourhood queries.
+		constexpr int VIEW_QUERIES = 4;
+		constexpr int NEIGHBOUR_QUERIES_PER_ENTITY = 1;
+		constexpr int CLUSTERS = 8;
+
+		struct Entity {
+			Spatial::AABB bounds;
+			Spatial::Point velocity;	// map pixels per frame
+		};
+
+		struct Timings {
+			double insert = 0.0;		// ms for all entities
+			double update = 0.0;		// ms per frame
+			double query = 0.0;			// ms per frame
+			size_t found = 0;			// items reported over all frames, the same for every structure
+		};
+
+		double ElapsedMilliseconds( Uint64 begin ) {
+			return ( SDL_GetPerformanceCounter( ) - begin ) * 1000.0 / SDL_GetPerformanceFrequency( );
+		}
+
+		std::vector<Entity> CreateEntities( std::string_view distribution, const SpatialBenchmarkConfig &config ) {
+			std::mt19937 random( 1234 );
+			const Spatial::AABB &world = config.world;
+			std::uniform_real_distribution<float> x( world.center.x - world.half_dim.x, world.center.x + world.half_dim.x );
+			std::uniform_real_distribution<float> y( world.center.y - world.half_dim.y, world.center.y + world.half_dim.y );
+			std::uniform_real_distribution<float> speed( -2.0f, 2.0f );
+			std::uniform_real_distribution<float> size( 0.25f, 4.0f );
+
+			std::vector<Spatial::Point> clusters( CLUSTERS );
+			for ( Spatial::Point &cluster : clusters ) {
+				cluster = { x( random ), y( random ) };
+			}
+			std::normal_distribution<float> spread( 0.0f, 4.0f * std::max( config.cellWidth, config.cellHeight ) );
+
+			std::vector<Entity> entities( config.entities );
+			for ( Entity &entity : entities ) {
+				entity.bounds.half_dim = { config.cellWidth * 0.4f, config.cellHeight * 0.4f };
+				if ( distribution == "clustered" ) {
+					const Spatial::Point &cluster = clusters[random( ) % CLUSTERS];
+					entity.bounds.center = { cluster.x + spread( random ), cluster.y + spread( random ) };
+				} else {
+					entity.bounds.center = { x( random ), y( random ) };
+				}
+				if ( distribution == "mixed" ) {
+					entity.bounds.half_dim.x *= size( random );
+					entity.bounds.half_dim.y *= size( random );
+				}
+				entity.velocity = { speed( random ), speed( random ) };
+			}
+			return entities;
+		}
+
+		template <Spatial::SpatialIndex Index>
+		Timings Measure( Index &index, std::vector<Entity> entities, const SpatialBenchmarkConfig &config ) {
+			Timings timings;
+			std::vector<typename Index::Handle> handles( entities.size( ) );
+			std::vector<uint32_t> found( entities.size( ) );
+
+			Uint64 begin = SDL_GetPerformanceCounter( );
+			for ( size_t i = 0; i < entities.size( ); ++i ) {
+				handles[i] = index.insert( entities[i].bounds, static_cast< uint32_t >( i ) );
+			}
+			timings.insert = ElapsedMilliseconds( begin );
+
+			const Spatial::Point view = { 960.0f, 540.0f };
+			const Spatial::Point neighbourhood = { config.cellWidth * 1.5f, config.cellHeight * 1.5f };
+			const Spatial::AABB &world = config.world;
+			for ( int frame = 0; frame < config.frames; ++frame ) {
+				begin = SDL_GetPerformanceCounter( );
+				for ( size_t i = 0; i < entities.size( ); ++i ) {
+					Entity &entity = entities[i];
+					entity.bounds.center.x += entity.velocity.x;
+					entity.bounds.center.y += entity.velocity.y;
+					// Bounce off the world edges so the distribution stays the same.
+					if ( std::abs( entity.bounds.center.x - world.center.x ) > world.half_dim.x ) {
+						entity.velocity.x = -entity.velocity.x;
+					}
+					if ( std::abs( entity.bounds.center.y - world.center.y ) > world.half_dim.y ) {
+						entity.velocity.y = -entity.velocity.y;
+					}
+					index.update( handles[i], entity.bounds );
+				}
+				timings.update += ElapsedMilliseconds( begin );
+
+				begin = SDL_GetPerformanceCounter( );
+				for ( int view_query = 0; view_query < VIEW_QUERIES; ++view_query ) {
+					const Spatial::Point &center = entities[( frame * VIEW_QUERIES + view_query ) % entities.size( )].bounds.center;
+					timings.found += index.query( Spatial::AABB{ center, view }, std::span<uint32_t>( found ) );
+				}
+				for ( size_t i = 0; i < entities.size( ); i += NEIGHBOUR_QUERIES_PER_ENTITY ) {
+					timings.found += index.query( Spatial::AABB{ entities[i].bounds.center, neighbourhood }, std::span<uint32_t>( found ) );
+				}
+				timings.query += ElapsedMilliseconds( begin );
+			}
+			timings.update /= config.frames;
+			timings.query /= config.frames;
+			return timings;
+		}
+
+		void Print( const char *name, const Timings &timings ) {
+			std::cout << "  " << name << ": insert " << timings.insert << " ms, update " << timings.update
+				<< " ms/frame, query " << timings.query << " ms/frame" << std::endl;
+		}
+	}
+
+	void RunSpatialBenchmark( const SpatialBenchmarkConfig &config ) {
+		if ( config.entities <= 0 || config.frames <= 0 ) {
+			std::cerr << "Spatial benchmark needs at least one entity and one frame." << std::endl;
+			return;
+		}
+		std::cout << "Spatial benchmark: " << config.entities << " entities, " << config.frames << " frames, "
+			<< config.world.half_dim.x * 2.0f << "x" << config.world.half_dim.y * 2.0f << " px world, "
+			<< config.cellWidth << "x" << config.cellHeight << " px cells" << std::endl;
+
+		for ( const char *distribution : { "uniform", "clustered", "mixed" } ) {
+			const std::vector<Entity> entities = CreateEntities( distribution, config );
+
+			QuadTree::DynamicQuadTree<uint32_t> tree( 0, config.world );
+			const Timings treeTimings = Measure( tree, entities, config );
+
+			Spatial::SpatialHashGrid<uint32_t> grid( config.cellWidth, config.cellHeight );
+			const Timings gridTimings = Measure( grid, entities, config );
+
+			std::cout << distribution << ":" << std::endl;
+			Print( "quad tree", treeTimings );
+			Print( "hash grid", gridTimings );
+			if ( treeTimings.found != gridTimings.found ) {
+				std::cerr << "  Results differ: quad tree found " << treeTimings.found << ", hash grid " << gridTimings.found << std::endl;
+			}
+			const double treeFrame = treeTimings.update + treeTimings.query;
+			const double gridFrame = gridTimings.update + gridTimings.query;
+			std::cout << "  winner: " << ( gridFrame < treeFrame ? "hash grid" : "quad tree" ) << " ("
+				<< std::max( treeFrame, gridFrame ) / std::max( std::min( treeFrame, gridFrame ), 1e-6 ) << "x)" << std::endl;
+		}
+	}
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "SpatialHash.hpp"
+
+namespace SiegePerilous {
+
+	struct SpatialBenchmarkConfig {
+		Spatial::AABB world{ };		// area the entities move in, map pixels
+		float cellWidth = 32.0f;	// grid cell size, the tile size of the map
+		float cellHeight = 32.0f;
+		int entities = 10000;
+		int frames = 120;
+	};
+
+	// Runs the same entity workload against QuadTree::DynamicQuadTree and Spatial::SpatialHashGrid
+	// for a uniform, a clustered and a mixed size distribution, and prints per frame timings and
+	// the faster structure of each.
+	void RunSpatialBenchmark( const SpatialBenchmarkConfig &config );
+}
@@ -0,0 +1,348 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <concepts>
+#include <iterator>
+#include <span>
+#include "QuadTree.hpp"
+
+namespace Spatial {
+	using Point = QuadTree::Point;
+	using AABB = QuadTree::AABB;
+
+	// What gameplay code needs from a broadphase: handles for AABB items that can be moved and
+	// removed, and allocation-free queries. Satisfied by QuadTree::DynamicQuadTree and
+	// SpatialHashGrid, so a system can be written once against either.
+	template <typename Index>
+	concept SpatialIndex = requires( Index index, const Index constIndex, const AABB bounds, const typename Index::value_type value,
+		typename Index::Handle handle, std::span<typename Index::value_type> out ) {
+		{ index.insert( bounds, value ) } -> std::same_as<typename Index::Handle>;
+		index.remove( handle );
+		index.update( handle, bounds );
+		index.clear( );
+		{ constIndex.get( handle ) } -> std::convertible_to<const typename Index::value_type &>;
+		{ constIndex.get_bounds( handle ) } -> std::convertible_to<const AABB &>;
+		{ constIndex.size( ) } -> std::convertible_to<size_t>;
+		{ constIndex.query( bounds, out ) } -> std::convertible_to<size_t>;
+		{ constIndex.query( bounds, [] ( const typename Index::value_type & ) { return true; } ) } -> std::same_as<bool>;
+	};
+
+	// Uniform grid for items of similar size spread evenly over the map. Every item is listed in
+	// each cell its bounds touch; the occupied cells live in an open addressing hash table with
+	// linear probing, so empty parts of the map cost nothing. Pick the cell size close to the
+	// typical item size, e.g. the map's tile size.
+	//
+	// Items touching more than LARGE_ITEM_CELLS cells are kept in a separate list that every
+	// query checks, so a few big items do not flood the table.
+	template <typename T>
+	class SpatialHashGrid {
+	public:
+		using value_type = T;
+		using Handle = uint32_t;
+		static constexpr Handle INVALID_HANDLE = ~0u;
+
+		static constexpr int LARGE_ITEM_CELLS = 16;
+
+		SpatialHashGrid( float p_cellWidth, float p_cellHeight ) :
+			cellWidth( std::max( p_cellWidth, 1.0f ) ), cellHeight( std::max( p_cellHeight, 1.0f ) ) {
+			slots.resize( 64 );
+		}
+
+		Handle insert( const AABB &bounds, const T &value ) {
+			Handle handle;
+			if ( freeItem != NONE ) {
+				handle = freeItem;
+				freeItem = items[handle].nextFree;
+			} else {
+				handle = static_cast< Handle >( items.size( ) );
+				items.emplace_back( );
+			}
+			Item &item = items[handle];
+			item.bounds = bounds;
+			item.value = value;
+			item.cells = get_cells( bounds );
+			item.live = true;
+			add_to_cells( handle );
+			++count;
+			return handle;
+		}
+
+		void remove( Handle handle ) {
+			assert( handle < items.size( ) && items[handle].live && "Removing a handle that is not alive." );
+			remove_from_cells( handle );
+			Item &item = items[handle];
+			item.live = false;
+			item.value = T( );
+			item.nextFree = freeItem;
+			freeItem = handle;
+			--count;
+		}
+
+		// Moves an item. The cells are only touched if it covers other cells than before.
+		void update( Handle handle, const AABB &newBounds ) {
+			assert( handle < items.size( ) && items[handle].live && "Updating a handle that is not alive." );
+			const CellRange cells = get_cells( newBounds );
+			items[handle].bounds = newBounds;
+			if ( cells == items[handle].cells ) {
+				return;
+			}
+			remove_from_cells( handle );
+			items[handle].cells = cells;
+			add_to_cells( handle );
+		}
+
+		const T &get( Handle handle ) const { return items[handle].value; }
+		const AABB &get_bounds( Handle handle ) const { return items[handle].bounds; }
+		size_t size( ) const { return count; }
+
+		// Removes every item, handles become invalid. The pools keep their memory.
+		void clear( ) {
+			std::fill( slots.begin( ), slots.end( ), Slot{ } );
+			usedSlots = 0;
+			entries.clear( );
+			freeEntry = NONE;
+			items.clear( );
+			freeItem = NONE;
+			largeItems.clear( );
+			count = 0;
+		}
+
+		std::vector<T> query( const AABB &range ) const {
+			std::vector<T> found;
+			query( range, std::back_inserter( found ) );
+			return found;
+		}
+
+		// Calls visitor( value ) once for every item whose bounds intersect range, without allocating.
+		// Returns false if the visitor stopped the query early by returning false.
+		template <typename Visitor> requires std::invocable<Visitor &, const T &>
+		bool query( const AABB &range, Visitor &&visitor ) const {
+			for ( uint32_t handle : largeItems ) {
+				if ( items[handle].bounds.intersects( range ) && !QuadTree::detail::visit( visitor, items[handle].value ) ) {
+					return false;
+				}
+			}
+
+			const CellRange cells = get_cells( range );
+			// An item spanning several cells is reported only from the first cell it shares with the range.
+			auto visitCell = [&] ( const Slot &slot ) {
+				for ( uint32_t e = slot.firstEntry; e != NONE; e = entries[e].next ) {
+					const Item &item = items[entries[e].item];
+					if ( std::max( item.cells.minX, cells.minX ) == slot.x && std::max( item.cells.minY, cells.minY ) == slot.y &&
+						item.bounds.intersects( range ) && !QuadTree::detail::visit( visitor, item.value ) ) {
+						return false;
+					}
+				}
+				return true;
+			};
+
+			// Big ranges walk the occupied slots instead of probing every cell.
+			if ( cells.get_count( ) > static_cast< int64_t >( usedSlots ) ) {
+				for ( const Slot &slot : slots ) {
+					if ( slot.firstEntry != NONE && cells.contains( slot.x, slot.y ) && !visitCell( slot ) ) {
+						return false;
+					}
+				}
+				return true;
+			}
+
+			for ( int32_t y = cells.minY; y <= cells.maxY; ++y ) {
+				for ( int32_t x = cells.minX; x <= cells.maxX; ++x ) {
+					const size_t slot = find_slot( x, y );
+					if ( slots[slot].firstEntry != NONE && !visitCell( slots[slot] ) ) {
+						return false;
+					}
+				}
+			}
+			return true;
+		}
+
+		// Writes the items intersecting range to out, returns the iterator past the last one written.
+		template <std::output_iterator<const T &> OutputIt>
+		OutputIt query( const AABB &range, OutputIt out ) const {
+			query( range, [&out] ( const T &value ) { *out++ = value; } );
+			return out;
+		}
+
+		// Fills out with the items intersecting range and stops once it is full.
+		// Returns the number of items written.
+		size_t query( const AABB &range, std::span<T> out ) const {
+			size_t written = 0;
+			if ( !out.empty( ) ) {
+				query( range, [&] ( const T &value ) {
+					out[written++] = value;
+					return written < out.size( );
+				} );
+			}
+			return written;
+		}
+
+	private:
+		static constexpr uint32_t NONE = ~0u;
+		// Cell coordinates are clamped to this, far beyond any map.
+		static constexpr float MAX_CELL = 1 << 30;
+
+		struct CellRange {
+			int32_t minX = 0, minY = 0, maxX = -1, maxY = -1;
+
+			bool operator==( const CellRange & ) const = default;
+			int64_t get_count( ) const { return int64_t( maxX - minX + 1 ) * int64_t( maxY - minY + 1 ); }
+			bool contains( int32_t x, int32_t y ) const { return x >= minX && x <= maxX && y >= minY && y <= maxY; }
+		};
+
+		struct Item {
+			AABB bounds{ };
+			T value{ };
+			CellRange cells;
+			uint32_t nextFree = NONE;
+			bool live = false;			// cleared by remove, catches stale handles in remove and update
+		};
+
+		// An item listed in a cell.
+		struct Entry {
+			uint32_t item;
+			uint32_t next;		// next entry of the same cell, also links the free entries
+		};
+
+		// A slot is empty when it has no entries, cells are erased as soon as their last entry goes.
+		struct Slot {
+			int32_t x = 0;
+			int32_t y = 0;
+			uint32_t firstEntry = NONE;
+		};
+
+		int32_t to_cell( float value, float size ) const {
+			return static_cast< int32_t >( std::clamp( std::floor( value / size ), -MAX_CELL, MAX_CELL ) );
+		}
+
+		CellRange get_cells( const AABB &bounds ) const {
+			return {
+				to_cell( bounds.center.x - bounds.half_dim.x, cellWidth ), to_cell( bounds.center.y - bounds.half_dim.y, cellHeight ),
+				to_cell( bounds.center.x + bounds.half_dim.x, cellWidth ), to_cell( bounds.center.y + bounds.half_dim.y, cellHeight ) };
+		}
+
+		size_t hash( int32_t x, int32_t y ) const {
+			uint64_t key = ( uint64_t( uint32_t( x ) ) << 32 ) | uint32_t( y );
+			key *= 0x9E3779B97F4A7C15ull;
+			return static_cast< size_t >( key ^ ( key >> 29 ) ) & ( slots.size( ) - 1 );
+		}
+
+		// The slot of the cell, or the empty slot where it would go.
+		size_t find_slot( int32_t x, int32_t y ) const {
+			size_t slot = hash( x, y );
+			while ( slots[slot].firstEntry != NONE && ( slots[slot].x != x || slots[slot].y != y ) ) {
+				slot = ( slot + 1 ) & ( slots.size( ) - 1 );
+			}
+			return slot;
+		}
+
+		void add_to_cells( Handle handle ) {
+			const CellRange cells = items[handle].cells;
+			if ( cells.get_count( ) > LARGE_ITEM_CELLS ) {
+				largeItems.push_back( handle );
+				return;
+			}
+			for ( int32_t y = cells.minY; y <= cells.maxY; ++y ) {
+				for ( int32_t x = cells.minX; x <= cells.maxX; ++x ) {
+					// Keep the table at most half full.
+					if ( ( usedSlots + 1 ) * 2 > slots.size( ) ) {
+						grow( );
+					}
+					const size_t slot = find_slot( x, y );
+					if ( slots[slot].firstEntry == NONE ) {
+						slots[slot].x = x;
+						slots[slot].y = y;
+						++usedSlots;
+					}
+
+					uint32_t entry;
+					if ( freeEntry != NONE ) {
+						entry = freeEntry;
+						freeEntry = entries[entry].next;
+					} else {
+						entry = static_cast< uint32_t >( entries.size( ) );
+						entries.emplace_back( );
+					}
+					entries[entry] = { handle, slots[slot].firstEntry };
+					slots[slot].firstEntry = entry;
+				}
+			}
+		}
+
+		void remove_from_cells( Handle handle ) {
+			const CellRange cells = items[handle].cells;
+			if ( cells.get_count( ) > LARGE_ITEM_CELLS ) {
+				auto it = std::find( largeItems.begin( ), largeItems.end( ), handle );
+				*it = largeItems.back( );
+				largeItems.pop_back( );
+				return;
+			}
+			for ( int32_t y = cells.minY; y <= cells.maxY; ++y ) {
+				for ( int32_t x = cells.minX; x <= cells.maxX; ++x ) {
+					const size_t slot = find_slot( x, y );
+					uint32_t *link = &slots[slot].firstEntry;
+					while ( entries[*link].item != handle ) {
+						link = &entries[*link].next;
+					}
+					const uint32_t entry = *link;
+					*link = entries[entry].next;
+					entries[entry].next = freeEntry;
+					freeEntry = entry;
+
+					if ( slots[slot].firstEntry == NONE ) {
+						erase_slot( slot );
+					}
+				}
+			}
+		}
+
+		// Backward shift deletion: later slots of the probe chain move up into the hole, so lookups
+		// never need tombstones.
+		void erase_slot( size_t hole ) {
+			const size_t mask = slots.size( ) - 1;
+			size_t slot = hole;
+			for ( ;; ) {
+				slot = ( slot + 1 ) & mask;
+				if ( slots[slot].firstEntry == NONE ) {
+					break;
+				}
+				const size_t home = hash( slots[slot].x, slots[slot].y );
+				// The entry may fill the hole unless its home lies cyclically in ( hole, slot ].
+				const bool stays = hole < slot ? ( home > hole && home <= slot ) : ( home > hole || home <= slot );
+				if ( !stays ) {
+					slots[hole] = slots[slot];
+					hole = slot;
+				}
+			}
+			slots[hole] = Slot{ };
+			--usedSlots;
+		}
+
+		void grow( ) {
+			std::vector<Slot> old( slots.size( ) * 2 );
+			old.swap( slots );
+			for ( const Slot &slot : old ) {
+				if ( slot.firstEntry != NONE ) {
+					slots[find_slot( slot.x, slot.y )] = slot;
+				}
+			}
+		}
+
+		float cellWidth;
+		float cellHeight;
+		std::vector<Slot> slots;
+		size_t usedSlots = 0;
+		std::vector<Entry> entries;
+		uint32_t freeEntry = NONE;
+		std::vector<Item> items;
+		uint32_t freeItem = NONE;
+		std::vector<uint32_t> largeItems;
+		size_t count = 0;
+	};
+
+	static_assert( SpatialIndex<QuadTree::DynamicQuadTree<uint32_t>> );
+	static_assert( SpatialIndex<SpatialHashGrid<uint32_t>> );
+}
@@ -2,12 +2,23 @@
 #include "tiled_data.h"
 #include <SDL3_image/SDL_image.h>
 #include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <limits>
 #include "ShapeFactory.h"
 #include "ChainShapeCreator.h"
 #include "aseprite_data.h"
 #include "ContentFactory.h"
 #include "ContentFactory.h"
 #include "Sprite.h"
+#include "gfx/tile_atlas.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+#include "SpatialBenchmark.h"
+
+static float ElapsedMilliseconds( Uint64 begin, Uint64 end ) {
+	return static_cast< float >( ( end - begin ) * 1000.0 / SDL_GetPerformanceFrequency( ) );
+}
 
 SiegePerilous::WorldState::WorldState( ) : m_isInitialized( false ), m_isRunning( false ), m_debugDraw( nullptr ), m_camera( nullptr ), m_shapeFactory(std::make_unique<ShapeFactory>()) {
 	physicsState.worldId = B2_NULL_ID;
@@ -48,10 +59,13 @@ bool SiegePerilous::WorldState::Initialise( ) {
 	if ( m_isInitialized ) {
 		return true; // Already initialized
 	}
+	SP_PROFILE_SCOPE( "WorldState::Initialise" );
 	Content::content_cache_item<SiegePerilous::AseSprite>( "sprites" );
 
 	b2WorldDef worldDef = b2DefaultWorldDef( );
 	worldDef.gravity = b2Vec2( { 0.0f, -10.f } );
+	// Solver stages run on the engine's workers.
+	jobSystem->SetupWorldDef( worldDef );
 	physicsState.worldId = b2CreateWorld( &worldDef );
 
 	//b2BodyDef groundBodyDef = b2DefaultBodyDef( );
@@ -82,26 +96,39 @@ bool SiegePerilous::WorldState::Initialise( ) {
 	//m_shapeFactory->registerCreator( "aseSprite", std::make_unique<AsepriteShapeCreator>( ) );
 
 	m_map = Tiled::load_map_with_deps( "tileMaps/main_menu.json" );
+	if ( !m_map ) {
+		std::cerr << "Error: Could not load the main menu map." << std::endl;
+		return false;
+	}
 
 	CreatePhysicsBodiesFromMap();
+	IndexObjectsFromMap( );
 
 	std::filesystem::path relPath = fileSystem->RelativeToOSPath( "main_menu.json" );
 	std::string relPathStr = relPath.string();
 	if ( m_map ) {
+		// Without a renderer (headless) only the data the simulation needs is loaded.
+		SDL_Renderer *renderer = m_camera.GetRenderer( );
+		TileAtlasBuilder tileAtlas;
+
+		SP_PROFILE_SCOPE( "Load tileset textures" );
 		// Iterate through each tileset defined in the map
 		for ( const auto &tileset : m_map->tilesets ) {
+			const int32_t tilesetIndex = static_cast< int32_t >( &tileset - m_map->tilesets.data( ) );
 
 			// 1. Handle the main tileset image (the spritesheet)
-			if ( tileset.image ) {
+			if ( tileset.image && renderer ) {
 				std::string image_path = *tileset.image;
 
 				SDL_Surface *surface = IMG_Load( fileSystem->RelativeToOSPath( image_path ).string().c_str() );
 				if ( surface ) {
-					SDL_Texture *texture = SDL_CreateTextureFromSurface( m_camera.GetRenderer( ), surface );
+					SDL_Texture *texture = SDL_CreateTextureFromSurface( renderer, surface );
 					if ( texture ) {
-						// Store the main tileset texture with its firstgid as the key.
-						// This is used for rendering tiles from the spritesheet.
-						m_tileset_textures[tileset.firstgid] = texture;
+						// Every gid of the tileset renders from the spritesheet.
+						TextureHandle handle = m_textures.Register( texture );
+						for ( uint32_t gid = tileset.firstgid; gid < m_map->m_gid_index.size( ) && m_map->m_gid_index[gid].tileset == tilesetIndex; ++gid ) {
+							m_textures.BindGid( gid, handle );
+						}
 					} else {
 						std::cerr << "Failed to create texture from " << image_path << "! SDL_Error: " << SDL_GetError( ) << std::endl;
 					}
@@ -129,6 +156,7 @@ bool SiegePerilous::WorldState::Initialise( ) {
 						Tiled::ActiveAnimationState state;
 						state.definition = &m_map->m_animation_definitions[base_gid];
 						m_map->m_active_animations[base_gid] = state;
+						m_map->UpdateRenderGid( state );
 					}
 					
 					if ( tile.image ) {
@@ -188,24 +216,27 @@ bool SiegePerilous::WorldState::Initialise( ) {
 							}
 						}
 
-						else if ( SDL_Surface *surface = IMG_Load( fileSystem->RelativeToOSPath( image_path ).string( ).c_str( ) ) ) {
-							SDL_Texture *texture = SDL_CreateTextureFromSurface( m_camera.GetRenderer( ), surface );
-							if ( texture ) {
+						else if ( renderer ) {
+							if ( SDL_Surface *surface = IMG_Load( fileSystem->RelativeToOSPath( image_path ).string( ).c_str( ) ) ) {
 								// Calculate the Global ID (GID) for this tile
 								uint32_t gid = tileset.firstgid + tile.id;
-								// Store the individual tile texture using its GID as the key.
-								m_tileset_textures[gid] = texture;
+								// The image is packed into a shared atlas page once all tilesets are loaded.
+								tileAtlas.Add( gid, surface );
 							} else {
-								std::cerr << "Failed to create texture for tile from " << image_path << "! SDL_Error: " << SDL_GetError( ) << std::endl;
+								std::cerr << "Failed to load individual tile image " << image_path << "! IMG_Error: " /*<< IMG_GetError( ) */<< std::endl;
 							}
-							SDL_DestroySurface( surface );							
-						} else {
-							std::cerr << "Failed to load individual tile image " << image_path << "! IMG_Error: " /*<< IMG_GetError( ) */<< std::endl;
 						}
 					}
 				}
 			}
 		}
+
+		if ( renderer ) {
+			tileAtlas.Build( renderer, m_textures );
+
+			// Everything the tile layers need is loaded now, decode them once.
+			m_tileRenderer.Build( *m_map, m_textures );
+		}
 	}
 
 	return true;
@@ -217,24 +248,40 @@ void SiegePerilous::WorldState::Shutdown( ) {
 		delete m_debugDraw;
 		m_debugDraw = nullptr;
 
-		for ( auto const &[key, val] : m_tileset_textures ) {
-			SDL_DestroyTexture( val );
-		}
-		m_tileset_textures.clear( );
+		m_tileRenderer.Clear( );
+		m_textures.Clear( );
+
+		m_quadTree.reset( );
+		m_objects.clear( );
+		m_objectParallax.clear( );
+		m_pickedObject = -1;
 
 		m_isInitialized = false;
 	}
 }
 
 void SiegePerilous::WorldState::Update( ) {
+	SP_PROFILE_SCOPE( "WorldState::Update" );
+	const Uint64 updateBegin = SDL_GetPerformanceCounter( );
+	m_frameSample.frameTime = m_lastUpdateCounter ? ElapsedMilliseconds( m_lastUpdateCounter, updateBegin ) : 0.0f;
+	m_lastUpdateCounter = updateBegin;
+
 	double newTime = SDL_GetTicks( ) / 1000.0;
 	double frameTime = newTime - currentTime;
 	currentTime = newTime;
+
+	Step( frameTime );
+	m_frameSample.updateTime = ElapsedMilliseconds( updateBegin, SDL_GetPerformanceCounter( ) );
+}
+
+void SiegePerilous::WorldState::Step( double frameTime ) {
 	accumulator += frameTime;
 
 	if (m_map)
 	{
+		SP_PROFILE_SCOPE( "Animations" );
 		double frameTime_ms = frameTime * 1000;
+		bool frameChanged = false;
 		for ( auto &[gid, anim_state] : m_map->m_active_animations ) {
 			anim_state.time_accumulator_ms += frameTime_ms;
 
@@ -249,164 +296,275 @@ void SiegePerilous::WorldState::Update( ) {
 				if ( anim_state.current_frame_index >= anim_state.definition->frames.size( ) ) {
 					anim_state.current_frame_index = 0;
 				}
+
+				// Publish the new frame so drawing is a single lookup per tile.
+				m_map->UpdateRenderGid( anim_state );
+				frameChanged = true;
 			}
 		}
+		if ( frameChanged ) {
+			++m_map->m_animation_revision;
+		}
 	}
 
-	const float timeStep = 1.0f / 30.0;
+	SP_PROFILE_SCOPE( "Physics" );
+	const Uint64 physicsBegin = SDL_GetPerformanceCounter( );
+	const float timeStep = FIXED_TIME_STEP;
 	while ( accumulator >= timeStep ) {
 		b2World_Step( physicsState.worldId, timeStep, 4 );
 		accumulator -= timeStep;
 	}
+	m_frameSample.physicsTime = ElapsedMilliseconds( physicsBegin, SDL_GetPerformanceCounter( ) );
 }
 
-void SiegePerilous::WorldState::Draw( ) {
-	if ( m_map ) {
-		SDL_Renderer *renderer = m_camera.GetRenderer( );
-		for ( auto &layerRefPtr : m_map->GetLayersOfType( "tilelayer", true, true ) ) {
-			Tiled::Layer &layer = *layerRefPtr;
-			if ( layer.type == "tilelayer" && layer.visible && layer.width.has_value( ) && layer.height.has_value( ) ) {
-				for ( int y = 0; y < *layer.height; ++y ) {
-					for ( int x = 0; x < *layer.width; ++x ) {
-						uint32_t raw_gid = layer.decoded_data[y * ( *layer.width ) + x];
-						if ( raw_gid == 0 ) {
-							continue;
-						}
-
-						static const uint32_t FLIPPED_HORIZONTALLY_FLAG = 0x80000000;
-						static const uint32_t FLIPPED_VERTICALLY_FLAG = 0x40000000;
-						static const uint32_t FLIPPED_DIAGONALLY_FLAG = 0x20000000;
-						static const uint32_t ALL_FLAGS_MASK = ( FLIPPED_HORIZONTALLY_FLAG | FLIPPED_VERTICALLY_FLAG | FLIPPED_DIAGONALLY_FLAG );
+void SiegePerilous::WorldState::RunHeadless( int ticks ) {
+	const double frequency = static_cast< double >( SDL_GetPerformanceFrequency( ) );
+	double minTick = 0.0;
+	double maxTick = 0.0;
+
+	const Uint64 start = SDL_GetPerformanceCounter( );
+	Uint64 tickStart = start;
+	for ( int tick = 0; tick < ticks && m_isRunning; ++tick ) {
+		Step( FIXED_TIME_STEP );
+
+		const Uint64 now = SDL_GetPerformanceCounter( );
+		const double tickTime = ( now - tickStart ) / frequency;
+		minTick = tick == 0 ? tickTime : std::min( minTick, tickTime );
+		maxTick = std::max( maxTick, tickTime );
+		tickStart = now;
+	}
+	const double total = ( SDL_GetPerformanceCounter( ) - start ) / frequency;
 
-						// 1. Extract flags and clean the GID
-						const bool flipped_horizontally = ( raw_gid & FLIPPED_HORIZONTALLY_FLAG );
-						const bool flipped_vertically = ( raw_gid & FLIPPED_VERTICALLY_FLAG );
-						const bool flipped_diagonally = ( raw_gid & FLIPPED_DIAGONALLY_FLAG );
-						const uint32_t gid = raw_gid & ~ALL_FLAGS_MASK; // Use this clean GID for lookups
+	const double simulated = ticks * static_cast< double >( FIXED_TIME_STEP );
+	std::cout << "Headless run: " << ticks << " ticks, " << simulated << " s simulated in " << total * 1000.0 << " ms" << std::endl;
+	if ( ticks > 0 && total > 0.0 ) {
+		std::cout << "  per tick avg " << total * 1000.0 / ticks << " ms, min " << minTick * 1000.0 << " ms, max " << maxTick * 1000.0 << " ms" << std::endl;
+		std::cout << "  " << ticks / total << " ticks/s, " << simulated / total << "x real time" << std::endl;
+	}
+}
 
+void SiegePerilous::WorldState::RunSpatialBenchmark( int entities ) {
+	SpatialBenchmarkConfig config;
+	config.entities = entities;
+	// Infinite maps have no size, a square of 128 tiles stands in for them.
+	int width = 128;
+	int height = 128;
+	if ( m_map ) {
+		config.cellWidth = static_cast< float >( m_map->tilewidth );
+		config.cellHeight = static_cast< float >( m_map->tileheight );
+		if ( !m_map->infinite ) {
+			width = m_map->width;
+			height = m_map->height;
+		}
+	}
+	const Spatial::Point halfSize = { width * config.cellWidth * 0.5f, height * config.cellHeight * 0.5f };
+	config.world = { halfSize, halfSize };
+	SiegePerilous::RunSpatialBenchmark( config );
+}
 
+void SiegePerilous::WorldState::Draw( ) {
+	SP_PROFILE_SCOPE( "WorldState::Draw" );
+	const Uint64 drawBegin = SDL_GetPerformanceCounter( );
+	if ( m_map ) {
+		// Only the objects the camera can see are handed to the renderer.
+		const b2AABB viewBounds = m_camera.GetViewBounds( );
+		const SDL_FPoint viewMin = Camera::ConvertWorldToMap( { viewBounds.lowerBound.x, viewBounds.upperBound.y } );
+		const SDL_FPoint viewMax = Camera::ConvertWorldToMap( { viewBounds.upperBound.x, viewBounds.lowerBound.y } );
+		QueryObjects( viewMin, viewMax, m_foundObjects );
+		m_visibleTileObjects.clear( );
+		for ( uint32_t index : m_foundObjects ) {
+			if ( m_objects[index].object->gid ) {
+				m_visibleTileObjects.push_back( m_objects[index] );
+			}
+		}
 
-						//////////////////////////////////////////////////////////////////////////
-						///tile animation
-						uint32_t render_gid = gid;
+		m_tileRenderer.Draw( m_camera.GetRenderer( ), *m_map, m_camera, m_visibleTileObjects );
+
+		if ( m_pickedObject >= 0 ) {
+			const Tiled::Layer &layer = *m_objects[m_pickedObject].layer;
+			const SDL_FPoint shift = GetParallaxShift( { static_cast< float >( layer.parallaxx ), static_cast< float >( layer.parallaxy ) } );
+			const QuadTree::AABB &bounds = m_quadTree->get_bounds( static_cast< uint32_t >( m_pickedObject ) );
+			const SDL_FPoint topLeft = m_camera.ConvertWorldToScreen( Camera::ConvertMapToWorld( {
+				bounds.center.x - bounds.half_dim.x + shift.x, bounds.center.y - bounds.half_dim.y + shift.y } ) );
+			const SDL_FPoint bottomRight = m_camera.ConvertWorldToScreen( Camera::ConvertMapToWorld( {
+				bounds.center.x + bounds.half_dim.x + shift.x, bounds.center.y + bounds.half_dim.y + shift.y } ) );
+			const SDL_FRect outline = { topLeft.x, topLeft.y, bottomRight.x - topLeft.x, bottomRight.y - topLeft.y };
+
+			SDL_Renderer *renderer = m_camera.GetRenderer( );
+			Uint8 r, g, b, a;
+			SDL_GetRenderDrawColor( renderer, &r, &g, &b, &a );
+			SDL_SetRenderDrawColor( renderer, 255, 220, 0, 255 );
+			SDL_RenderRect( renderer, &outline );
+			SDL_SetRenderDrawColor( renderer, r, g, b, a );
+		}
+	}
 
-						// Check if the tile from the map is a base tile for an animation.
-						auto anim_it = m_map->m_active_animations.find( gid );
-						if ( anim_it != m_map->m_active_animations.end( ) ) {
-							// It is an animated tile. Get the GID of the current frame.
-							const Tiled::ActiveAnimationState &anim_state = anim_it->second;
-							const Tiled::Frame &current_frame = anim_state.definition->frames[anim_state.current_frame_index];
+	if ( m_debugDraw ) {
+		b2World_Draw( physicsState.worldId, m_debugDraw->getDebugDrawPtr( ) );
+	}
+	m_frameSample.drawTime = ElapsedMilliseconds( drawBegin, SDL_GetPerformanceCounter( ) );
+
+	// Recorded every frame so the graph is already filled when the overlay is toggled on.
+	const b2Counters counters = b2World_GetCounters( physicsState.worldId );
+	m_frameSample.drawCalls = m_tileRenderer.GetBatcher( ).GetDrawCalls( );
+	m_frameSample.tilesVisited = m_tileRenderer.GetTilesVisited( );
+	m_frameSample.tilesDrawn = m_tileRenderer.GetTilesDrawn( );
+	m_frameSample.bodyCount = counters.bodyCount;
+	m_frameSample.contactCount = counters.contactCount;
+	m_frameSample.textureMemory = m_textures.GetTextureMemory( ) + m_tileRenderer.GetChunkMemory( );
+	m_frameStats.AddFrame( m_frameSample );
+	m_frameStats.Draw( m_camera.GetRenderer( ) );
+}
 
-							// The tileset's firstgid is needed to resolve the local tileid to a global id.
-							const Tiled::Tileset *found_tileset = nullptr;
-							for ( const auto &ts : m_map->tilesets ) {
-								if ( gid >= ts.firstgid ) {
-									if ( !found_tileset || ts.firstgid > found_tileset->firstgid ) {
-										found_tileset = &ts;
-									}
-								}
-							}
-							if ( found_tileset ) {
-								render_gid = found_tileset->firstgid + current_frame.tileid;
-							}
-						}
-						//////////////////////////////////////////////////////////////////////////
-						
-						// 2. Determine the SDL_RendererFlip value and rotation angle.
-						// Tiled's diagonal flip is a 90-degree rotation plus a horizontal flip.
-						// The other flags are applied on top of that.
-						SDL_FlipMode flip = SDL_FLIP_NONE;
-						double angle = 0.0;
-
-						if (flipped_diagonally) {
-							angle = 90.0;
-							flip = SDL_FLIP_HORIZONTAL;
-						}
-						if (flipped_horizontally) {
-							// XOR the flip flag. If it was already set by the diagonal flip, it will be cleared, and vice-versa.
-							flip = (SDL_FlipMode)(flip ^ SDL_FLIP_HORIZONTAL);
-						}
-						if (flipped_vertically) {
-							flip = (SDL_FlipMode)(flip ^ SDL_FLIP_VERTICAL);
-						}
+void SiegePerilous::WorldState::Start( ) {
+	m_isRunning = true;
+}
 
-						// The destination rectangle on the screen
-						SDL_FRect dest_rect = {
-							x * m_map->tilewidth + layer.offsetx,
-							y * m_map->tileheight + layer.offsety,
-							m_map->tilewidth ,
-							m_map->tileheight
-						};
-
-						// Case 1: Check if this GID corresponds to an individual tile image
-						auto it = m_tileset_textures.find( render_gid );
-						if ( it != m_tileset_textures.end( ) ) {
-							SDL_Texture *texture = it->second;
-							
-							//hmmm i dont remeber why i need to do this only on Y..
-							//dest_rect.x +=  -texture->w + m_map->tilewidth;
-							dest_rect.y += -texture->h + m_map->tileheight;
+void SiegePerilous::WorldState::Stop( ) {
+	m_isRunning = false;
+}
 
-							dest_rect.w = texture->w;
-							dest_rect.h = texture->h;
-							SDL_RenderTexture( renderer, texture, nullptr, &dest_rect );
-						}
-						// Case 2: It's a tile from a larger tileset spritesheet
-						else {
-							const Tiled::Tileset *found_tileset = nullptr;
-							for ( const auto &ts : m_map->tilesets ) {
-								
-								SDL_assert(ts.firstgid >= 0);
-
-								if ( gid >= ts.firstgid ) {
-									if ( !found_tileset || ts.firstgid > found_tileset->firstgid ) {
-										found_tileset = &ts;
-									}
-								}
-							}
+const Tiled::Object *SiegePerilous::WorldState::PickObject( const SDL_FPoint &screenPoint ) {
+	m_pickedObject = -1;
+	if ( !m_map ) {
+		return nullptr;
+	}
 
-							if ( found_tileset ) {
-								auto ts_it = m_tileset_textures.find( found_tileset->firstgid );
-								if ( ts_it != m_tileset_textures.end( ) ) {
-									SDL_Texture *texture = ts_it->second;
+	const SDL_FPoint point = Camera::ConvertWorldToMap( m_camera.ConvertScreenToWorld( screenPoint ) );
+	QueryObjects( point, point, m_foundObjects );
+	if ( m_foundObjects.empty( ) ) {
+		return nullptr;
+	}
+	// The last one in draw order is on top.
+	m_pickedObject = static_cast< int >( m_foundObjects.back( ) );
+	return m_objects[m_pickedObject].object;
+}
 
-									uint32_t local_id = render_gid - found_tileset->firstgid;
-									int tile_width = found_tileset->tilewidth.value_or( 0 );
-									int tile_height = found_tileset->tileheight.value_or( 0 );
-									int columns = found_tileset->columns.value_or( 1 );
+// Bounds of an object in map pixels, layer offset included. Rotated objects get the box around
+// their rotated outline.
+static QuadTree::AABB GetObjectBounds( const Tiled::Map &map, const Tiled::Layer &layer, const Tiled::Object &object ) {
+	// Outline relative to the object's position, before the rotation around it.
+	double minX = 0.0, minY = 0.0, maxX = 0.0, maxY = 0.0;
+	const auto &points = object.polygon ? object.polygon : object.polyline;
+	if ( points && !points->empty( ) ) {
+		minX = maxX = points->front( ).x;
+		minY = maxY = points->front( ).y;
+		for ( const Tiled::Point &point : *points ) {
+			minX = std::min( minX, point.x );
+			maxX = std::max( maxX, point.x );
+			minY = std::min( minY, point.y );
+			maxY = std::max( maxY, point.y );
+		}
+	} else if ( object.gid ) {
+		// Tile objects are anchored at their bottom-left corner.
+		maxX = object.width > 0.0 ? object.width : map.tilewidth;
+		minY = -( object.height > 0.0 ? object.height : map.tileheight );
+	} else if ( !object.point ) {
+		maxX = object.width;
+		maxY = object.height;
+	}
 
-									if ( columns > 0 && tile_width > 0 && tile_height > 0 ) {
+	const double radians = object.rotation * ( SDL_PI_D / 180.0 );
+	const double c = std::cos( radians );
+	const double s = std::sin( radians );
+	const double corners[4][2] = { { minX, minY }, { maxX, minY }, { maxX, maxY }, { minX, maxY } };
+	double left = std::numeric_limits<double>::max( ), top = std::numeric_limits<double>::max( );
+	double right = std::numeric_limits<double>::lowest( ), bottom = std::numeric_limits<double>::lowest( );
+	for ( const auto &corner : corners ) {
+		const double x = corner[0] * c - corner[1] * s;
+		const double y = corner[0] * s + corner[1] * c;
+		left = std::min( left, x );
+		right = std::max( right, x );
+		top = std::min( top, y );
+		bottom = std::max( bottom, y );
+	}
 
-										SDL_FRect src_rect;
+	const double originX = object.x + layer.offsetx;
+	const double originY = object.y + layer.offsety;
+	return QuadTree::AABB{
+		{ static_cast< float >( originX + ( left + right ) * 0.5 ), static_cast< float >( originY + ( top + bottom ) * 0.5 ) },
+		{ static_cast< float >( ( right - left ) * 0.5 ), static_cast< float >( ( bottom - top ) * 0.5 ) } };
+}
 
-										src_rect.x = static_cast<float>(( local_id % columns ) * tile_width );
-										src_rect.y = static_cast<float>(( local_id / columns ) * tile_height );
-										src_rect.w = static_cast<float>( tile_width );
-										src_rect.h = static_cast<float>( tile_height );
+void SiegePerilous::WorldState::IndexObjectsFromMap( ) {
+	SP_PROFILE_SCOPE( "WorldState::IndexObjectsFromMap" );
+	m_objects.clear( );
+	m_objectParallax.clear( );
+	m_quadTree.reset( );
+	if ( !m_map ) {
+		return;
+	}
 
-										SDL_RenderTextureRotated(renderer, texture, &src_rect, &dest_rect, angle, nullptr, flip);
-									}
-								}
-							}
-						}
-					}
-				}
-			}
+	std::vector<std::pair<QuadTree::AABB, uint32_t>> entries;
+	for ( const Tiled::Layer *layer : m_map->GetLayersOfType( "objectgroup", true, true ) ) {
+		if ( !layer->objects || layer->objects->empty( ) ) {
+			continue;
+		}
+		const SDL_FPoint parallax = { static_cast< float >( layer->parallaxx ), static_cast< float >( layer->parallaxy ) };
+		if ( std::none_of( m_objectParallax.begin( ), m_objectParallax.end( ), [&] ( const SDL_FPoint &p ) { return p.x == parallax.x && p.y == parallax.y; } ) ) {
+			m_objectParallax.push_back( parallax );
+		}
+		for ( const Tiled::Object &object : *layer->objects ) {
+			entries.push_back( { GetObjectBounds( *m_map, *layer, object ), static_cast< uint32_t >( m_objects.size( ) ) } );
+			m_objects.push_back( { layer, &object } );
 		}
 	}
+	if ( m_objects.empty( ) ) {
+		return;
+	}
 
-
-	if ( m_debugDraw ) {
-		b2World_Draw( physicsState.worldId, m_debugDraw->getDebugDrawPtr( ) );
+	// The tree covers the objects, finite maps are covered as a whole.
+	float left = 0.0f, top = 0.0f;
+	float right = m_map->infinite ? 0.0f : static_cast< float >( m_map->width * m_map->tilewidth );
+	float bottom = m_map->infinite ? 0.0f : static_cast< float >( m_map->height * m_map->tileheight );
+	for ( const auto &[box, index] : entries ) {
+		left = std::min( left, box.center.x - box.half_dim.x );
+		right = std::max( right, box.center.x + box.half_dim.x );
+		top = std::min( top, box.center.y - box.half_dim.y );
+		bottom = std::max( bottom, box.center.y + box.half_dim.y );
 	}
+	m_quadTree.emplace( 0, QuadTree::AABB{
+		{ ( left + right ) * 0.5f, ( top + bottom ) * 0.5f },
+		{ std::max( ( right - left ) * 0.5f, 1.0f ), std::max( ( bottom - top ) * 0.5f, 1.0f ) } } );
+
+	m_quadTree->build( entries, [] ( size_t count, const auto &fn ) {
+		jobSystem->ParallelForAndWait( static_cast< int >( count ), 1, [&fn] ( int begin, int end ) {
+			fn( static_cast< size_t >( begin ), static_cast< size_t >( end ) );
+		} );
+	} );
+	std::cout << "Indexed " << m_objects.size( ) << " map objects." << std::endl;
 }
 
-void SiegePerilous::WorldState::Start( ) {
-	m_isRunning = true;
+SDL_FPoint SiegePerilous::WorldState::GetParallaxShift( const SDL_FPoint &parallax ) const {
+	// Tiled moves a layer with parallax factor f by ( viewCenter - parallaxOrigin ) * ( 1 - f ).
+	const SDL_FPoint viewCenter = Camera::ConvertWorldToMap( m_camera.GetCenter( ) );
+	return {
+		static_cast< float >( ( viewCenter.x - m_map->parallaxoriginx ) * ( 1.0 - parallax.x ) ),
+		static_cast< float >( ( viewCenter.y - m_map->parallaxoriginy ) * ( 1.0 - parallax.y ) )
+	};
 }
 
-void SiegePerilous::WorldState::Stop( ) {
-	m_isRunning = false;
+void SiegePerilous::WorldState::QueryObjects( const SDL_FPoint &viewMin, const SDL_FPoint &viewMax, std::vector<uint32_t> &found ) const {
+	found.clear( );
+	if ( !m_quadTree ) {
+		return;
+	}
+
+	// One query per parallax factor, the view moves against those layers.
+	const bool single = m_objectParallax.size( ) == 1;
+	for ( const SDL_FPoint &parallax : m_objectParallax ) {
+		const SDL_FPoint shift = GetParallaxShift( parallax );
+		const QuadTree::AABB range = {
+			{ ( viewMin.x + viewMax.x ) * 0.5f - shift.x, ( viewMin.y + viewMax.y ) * 0.5f - shift.y },
+			{ ( viewMax.x - viewMin.x ) * 0.5f, ( viewMax.y - viewMin.y ) * 0.5f } };
+		m_quadTree->query( range, [&] ( uint32_t index ) {
+			const Tiled::Layer &layer = *m_objects[index].layer;
+			if ( single || ( static_cast< float >( layer.parallaxx ) == parallax.x && static_cast< float >( layer.parallaxy ) == parallax.y ) ) {
+				found.push_back( index );
+			}
+		} );
+	}
+	std::sort( found.begin( ), found.end( ) );
 }
 
 void SiegePerilous::WorldState::CreatePhysicsBodiesFromMap()
@@ -12,10 +12,25 @@
 #include "QuadTree.hpp"
 #include "FileSystem.h"
 #include "ShapeFactory.h"
+#include "gfx/tile_renderer.h"
+#include "gfx/frame_stats.h"
 #include <memory>
 
 namespace SiegePerilous {
 
+	struct SimulationConfig {
+		bool headless = false;			// Run without window, renderer and audio.
+		int headlessTicks = 600;		// Fixed steps to simulate in headless mode before quitting.
+
+		struct glaze {
+			using T = SimulationConfig;
+			static constexpr auto value = glz::object(
+				"headless", &T::headless, "Run the simulation without window, renderer and audio",
+				"headlessTicks", &T::headlessTicks, "Number of fixed steps a headless run simulates"
+			);
+		};
+	};
+
 	struct AudioState {
 		SDL_AudioStream *stream_in;
 		SDL_AudioStream *stream_out;
@@ -34,8 +49,24 @@ namespace SiegePerilous {
 
 		void Update( );
 
+		// Advances animations and physics by frameTime seconds. Update calls it with the
+		// real time that passed since the last frame.
+		void Step( double frameTime );
+
+		// Simulates ticks fixed steps as fast as possible and prints how long they took.
+		// Needs no renderer, Initialise skips everything graphical when there is none.
+		void RunHeadless( int ticks );
+
+		// Compares the spatial index structures for the given number of entities moving over the
+		// loaded map, with grid cells the size of its tiles. Prints the results.
+		void RunSpatialBenchmark( int entities );
+
 		void Draw( );
 
+		// The topmost object of a visible object layer under a screen position, nullptr if there
+		// is none. Draw outlines it until the next pick.
+		const Tiled::Object *PickObject( const SDL_FPoint &screenPoint );
+
 		bool IsRunning( ) const { return m_isRunning; }
 		void Start( );
 		void Stop( );
@@ -44,8 +75,23 @@ namespace SiegePerilous {
 		AudioState audioState;
 
 		Camera &GetCamera( ) { return m_camera; }
+		TileRenderer &GetTileRenderer( ) { return m_tileRenderer; }
+		// Overlay with frame times and counters, Draw puts it on top when it is toggled on.
+		FrameStats &GetFrameStats( ) { return m_frameStats; }
+		static constexpr float FIXED_TIME_STEP = 1.0f / 30.0f;
+
 	private:
 		void CreatePhysicsBodiesFromMap();
+
+		// Puts the objects of every visible object layer into m_quadTree, in map pixels.
+		void IndexObjectsFromMap( );
+
+		// Indices of the objects whose bounds intersect the map pixel rect [viewMin, viewMax]
+		// as the camera sees it, in draw order. Each layer is shifted by its parallax.
+		void QueryObjects( const SDL_FPoint &viewMin, const SDL_FPoint &viewMax, std::vector<uint32_t> &found ) const;
+
+		// How far Tiled moves a layer with the given parallax factor for the current camera.
+		SDL_FPoint GetParallaxShift( const SDL_FPoint &parallax ) const;
 		bool m_isInitialized;
 		bool m_isRunning;
 		b2SDLDraw *m_debugDraw;
@@ -56,9 +102,24 @@ namespace SiegePerilous {
 		Camera m_camera;
 
 		std::optional<Tiled::Map> m_map;
-		std::map<int, SDL_Texture *> m_tileset_textures;
+		TextureRegistry m_textures;
+		TileRenderer m_tileRenderer;
+
+		FrameStats m_frameStats;
+		// Filled in by Update, Step and Draw, handed to m_frameStats at the end of Draw.
+		FrameSample m_frameSample;
+		Uint64 m_lastUpdateCounter = 0;
 		
-		QuadTree::QuadTree<int> *m_quadTree;
+		// Every indexed object in draw order, m_quadTree holds indices into it. The tree is bulk
+		// built, so an object's handle is its index as well.
+		std::vector<TileObject> m_objects;
+		std::optional<QuadTree::DynamicQuadTree<uint32_t>> m_quadTree;
+		// Distinct parallax factors of the indexed layers, every one takes a query of its own.
+		std::vector<SDL_FPoint> m_objectParallax;
+		// Scratch space of Draw and PickObject.
+		std::vector<uint32_t> m_foundObjects;
+		std::vector<TileObject> m_visibleTileObjects;
+		int m_pickedObject = -1;
 		FileSystem *m_fileSystem{};
 
 		std::unique_ptr<ShapeFactory> m_shapeFactory;
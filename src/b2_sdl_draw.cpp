@@ -232,6 +232,21 @@ b2AABB Camera::GetViewBounds( ) const {
 	return bounds;
 }
 
+float Camera::GetMapPixelsPerMeter( ) {
+	// The pixels per meter of the default view, see ResetView.
+	return static_cast< float >( SCREEN_HEIGHT ) / ( 20.0f * 2.0f );
+}
+
+b2Vec2 Camera::ConvertMapToWorld( const SDL_FPoint &mapPoint ) {
+	const float ppm = GetMapPixelsPerMeter( );
+	return { ( mapPoint.x - SCREEN_WIDTH / 2.0f ) / ppm, -( mapPoint.y - SCREEN_HEIGHT / 2.0f ) / ppm };
+}
+
+SDL_FPoint Camera::ConvertWorldToMap( const b2Vec2 &worldPoint ) {
+	const float ppm = GetMapPixelsPerMeter( );
+	return { worldPoint.x * ppm + SCREEN_WIDTH / 2.0f, -worldPoint.y * ppm + SCREEN_HEIGHT / 2.0f };
+}
+
 SDL_FPoint Camera::ConvertWorldToScreen( const b2Vec2 &worldPoint ) const {
 	float ppm = GetPixelsPerMeter( );
 
@@ -52,6 +52,15 @@ public:
 	// Calculates the visible area of the world.
 	b2AABB GetViewBounds( ) const;
 
+	// Map space is the pixel space the Tiled maps are authored in (Y-down). It lines up with
+	// the screen at the default view of a SCREEN_WIDTH x SCREEN_HEIGHT window, which is also
+	// how the physics shapes are placed from the map objects.
+	static b2Vec2 ConvertMapToWorld( const SDL_FPoint &mapPoint );
+	static SDL_FPoint ConvertWorldToMap( const b2Vec2 &worldPoint );
+
+	// Pixels per meter of map space.
+	static float GetMapPixelsPerMeter( );
+
 	// A helper to get the current scale factor. Useful for sizing objects.
 	float GetPixelsPerMeter( ) const;
 
@@ -61,6 +70,8 @@ public:
 	float GetZoom( ) const { return m_zoom; }
 	const b2Vec2 &GetCenter( ) const { return m_center; }
 	SDL_Renderer *GetRenderer( ) const { return m_renderer; }
+	int GetWidth( ) const { return m_width; }
+	int GetHeight( ) const { return m_height; }
 private:
 	SDL_Renderer *m_renderer;
 	int m_width;
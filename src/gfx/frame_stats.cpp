@@ -0,0 +1,94 @@
+#include "frame_stats.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace SiegePerilous {
+
+	namespace {
+		constexpr float MARGIN = 8.0f;
+		constexpr float LINE_HEIGHT = SDL_DEBUG_TEXT_FONT_CHARACTER_SIZE + 2.0f;
+		constexpr float BAR_WIDTH = 2.0f;
+		constexpr float GRAPH_HEIGHT = 100.0f;
+		constexpr int TEXT_LINES = 4;
+	}
+
+	void FrameStats::AddFrame( const FrameSample &sample ) {
+		m_samples[m_next] = sample;
+		m_next = ( m_next + 1 ) % HISTORY;
+		m_count = std::min( m_count + 1, HISTORY );
+	}
+
+	float FrameStats::GetPercentile( float fraction ) {
+		if ( m_count == 0 ) {
+			return 0.0f;
+		}
+		const int index = std::min( m_count - 1, static_cast< int >( std::ceil( fraction * m_count ) ) - 1 );
+		std::nth_element( m_sorted.begin( ), m_sorted.begin( ) + std::max( 0, index ), m_sorted.begin( ) + m_count );
+		return m_sorted[std::max( 0, index )];
+	}
+
+	void FrameStats::Draw( SDL_Renderer *renderer ) {
+		if ( !m_visible || !renderer || m_count == 0 ) {
+			return;
+		}
+
+		for ( int i = 0; i < m_count; ++i ) {
+			m_sorted[i] = m_samples[i].frameTime;
+		}
+		const float p50 = GetPercentile( 0.50f );
+		const float p95 = GetPercentile( 0.95f );
+		const float p99 = GetPercentile( 0.99f );
+
+		const FrameSample &last = m_samples[( m_next + HISTORY - 1 ) % HISTORY];
+
+		Uint8 r, g, b, a;
+		SDL_BlendMode blendMode;
+		SDL_GetRenderDrawColor( renderer, &r, &g, &b, &a );
+		SDL_GetRenderDrawBlendMode( renderer, &blendMode );
+		SDL_SetRenderDrawBlendMode( renderer, SDL_BLENDMODE_BLEND );
+
+		const float width = HISTORY * BAR_WIDTH;
+		const float graphTop = MARGIN + TEXT_LINES * LINE_HEIGHT + 4.0f;
+		const SDL_FRect panel = { MARGIN - 4.0f, MARGIN - 4.0f, width + 8.0f, graphTop + GRAPH_HEIGHT + 4.0f - ( MARGIN - 4.0f ) };
+		SDL_SetRenderDrawColor( renderer, 0, 0, 0, 176 );
+		SDL_RenderFillRect( renderer, &panel );
+
+		// The graph spans twice the budget, longer frames are clipped at the top.
+		const float msToPixels = GRAPH_HEIGHT / ( 2.0f * BUDGET_MS );
+		m_bars[0].clear( );
+		m_bars[1].clear( );
+		for ( int i = 0; i < m_count; ++i ) {
+			// Oldest frame on the left.
+			const FrameSample &sample = m_samples[( m_next - m_count + i + HISTORY ) % HISTORY];
+			const float height = std::min( GRAPH_HEIGHT, sample.frameTime * msToPixels );
+			const SDL_FRect bar = { MARGIN + ( HISTORY - m_count + i ) * BAR_WIDTH, graphTop + GRAPH_HEIGHT - height, BAR_WIDTH, height };
+			m_bars[sample.frameTime > BUDGET_MS ? 1 : 0].push_back( bar );
+		}
+		SDL_SetRenderDrawColor( renderer, 64, 200, 64, 255 );
+		SDL_RenderFillRects( renderer, m_bars[0].data( ), static_cast< int >( m_bars[0].size( ) ) );
+		SDL_SetRenderDrawColor( renderer, 230, 48, 48, 255 );
+		SDL_RenderFillRects( renderer, m_bars[1].data( ), static_cast< int >( m_bars[1].size( ) ) );
+
+		const float budgetY = graphTop + GRAPH_HEIGHT - BUDGET_MS * msToPixels;
+		SDL_SetRenderDrawColor( renderer, 255, 255, 255, 128 );
+		SDL_RenderLine( renderer, MARGIN, budgetY, MARGIN + width, budgetY );
+
+		SDL_SetRenderDrawColor( renderer, 255, 255, 255, 255 );
+		float y = MARGIN;
+		SDL_RenderDebugTextFormat( renderer, MARGIN, y, "frame %5.2f ms  p50 %5.2f  p95 %5.2f  p99 %5.2f",
+			last.frameTime, p50, p95, p99 );
+		y += LINE_HEIGHT;
+		SDL_RenderDebugTextFormat( renderer, MARGIN, y, "update %5.2f ms  physics %5.2f ms  draw %5.2f ms",
+			last.updateTime, last.physicsTime, last.drawTime );
+		y += LINE_HEIGHT;
+		SDL_RenderDebugTextFormat( renderer, MARGIN, y, "draw calls %d  tiles %u visited / %u drawn",
+			last.drawCalls, last.tilesVisited, last.tilesDrawn );
+		y += LINE_HEIGHT;
+		SDL_RenderDebugTextFormat( renderer, MARGIN, y, "bodies %d  contacts %d  textures %.1f MB",
+			last.bodyCount, last.contactCount, last.textureMemory / ( 1024.0 * 1024.0 ) );
+
+		SDL_SetRenderDrawBlendMode( renderer, blendMode );
+		SDL_SetRenderDrawColor( renderer, r, g, b, a );
+	}
+}
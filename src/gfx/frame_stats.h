@@ -0,0 +1,52 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace SiegePerilous {
+
+	// Everything the overlay shows about a single frame. Times are in milliseconds.
+	struct FrameSample {
+		float frameTime = 0.0f;		// real time between this frame and the previous one
+		float updateTime = 0.0f;	// WorldState::Update, physics included
+		float physicsTime = 0.0f;	// the Box2D steps of the frame
+		float drawTime = 0.0f;		// WorldState::Draw without the overlay itself
+		int drawCalls = 0;
+		uint32_t tilesVisited = 0;
+		uint32_t tilesDrawn = 0;
+		int bodyCount = 0;
+		int contactCount = 0;
+		size_t textureMemory = 0;	// bytes, registry textures plus chunk textures
+	};
+
+	// Keeps the last HISTORY frames and draws them as a graph with their percentiles and
+	// the numbers of the latest frame in the top-left corner. Uses SDL's debug text, so
+	// it works in every build without fonts or textures.
+	class FrameStats {
+	public:
+		static constexpr int HISTORY = 240;
+		// Frames above this are drawn red in the graph, the callback rate is 60 Hz.
+		static constexpr float BUDGET_MS = 1000.0f / 60.0f;
+
+		void AddFrame( const FrameSample &sample );
+
+		void Toggle( ) { m_visible = !m_visible; }
+		bool IsVisible( ) const { return m_visible; }
+
+		void Draw( SDL_Renderer *renderer );
+
+	private:
+		// Frame time below which fraction of the recorded frames fall, fraction in [0, 1].
+		float GetPercentile( float fraction );
+
+		std::array<FrameSample, HISTORY> m_samples{ };
+		int m_next = 0;
+		int m_count = 0;
+		bool m_visible = false;
+		// Scratch space reused every frame.
+		std::array<float, HISTORY> m_sorted{ };
+		std::vector<SDL_FRect> m_bars[2];
+	};
+}
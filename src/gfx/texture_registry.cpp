@@ -0,0 +1,54 @@
+#include "texture_registry.h"
+
+#include <algorithm>
+
+namespace SiegePerilous {
+
+	TextureHandle TextureRegistry::Register( SDL_Texture *texture ) {
+		if ( !texture || m_entries.size( ) >= INVALID_TEXTURE_HANDLE ) {
+			return INVALID_TEXTURE_HANDLE;
+		}
+
+		TextureEntry entry;
+		entry.texture = texture;
+		entry.width = texture->w;
+		entry.height = texture->h;
+		m_entries.push_back( entry );
+		m_textureMemory += static_cast< size_t >( entry.width ) * entry.height * 4;
+
+		return static_cast< TextureHandle >( m_entries.size( ) - 1 );
+	}
+
+	void TextureRegistry::BindGidRange( uint32_t firstGid, uint32_t count, TextureHandle handle ) {
+		const size_t end = static_cast< size_t >( firstGid ) + count;
+		if ( end > m_gidHandles.size( ) ) {
+			m_gidHandles.resize( end, INVALID_TEXTURE_HANDLE );
+			m_gidRegions.resize( end, SDL_Rect{ 0, 0, 0, 0 } );
+		}
+		std::fill( m_gidHandles.begin( ) + firstGid, m_gidHandles.begin( ) + end, handle );
+		std::fill( m_gidRegions.begin( ) + firstGid, m_gidRegions.begin( ) + end, SDL_Rect{ 0, 0, 0, 0 } );
+	}
+
+	void TextureRegistry::BindGidRegion( uint32_t gid, TextureHandle handle, const SDL_Rect &region ) {
+		BindGid( gid, handle );
+		m_gidRegions[gid] = region;
+	}
+
+	SDL_Rect TextureRegistry::GetImageRectForGid( uint32_t gid ) const {
+		if ( gid < m_gidRegions.size( ) && m_gidRegions[gid].w > 0 ) {
+			return m_gidRegions[gid];
+		}
+		const TextureEntry &entry = m_entries[GetHandleForGid( gid )];
+		return { 0, 0, entry.width, entry.height };
+	}
+
+	void TextureRegistry::Clear( ) {
+		for ( const TextureEntry &entry : m_entries ) {
+			SDL_DestroyTexture( entry.texture );
+		}
+		m_entries.clear( );
+		m_gidHandles.clear( );
+		m_gidRegions.clear( );
+		m_textureMemory = 0;
+	}
+}
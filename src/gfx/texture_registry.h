@@ -0,0 +1,63 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <cstdint>
+#include <vector>
+
+namespace SiegePerilous {
+
+	// Small integer handle to a texture owned by a TextureRegistry.
+	using TextureHandle = uint16_t;
+	constexpr TextureHandle INVALID_TEXTURE_HANDLE = UINT16_MAX;
+
+	struct TextureEntry {
+		SDL_Texture *texture;
+		int width;
+		int height;
+	};
+
+	// Owns the textures of a loaded map. Textures are handed out as handles at load
+	// time and kept in a flat vector, the gid -> handle mapping is a dense array.
+	class TextureRegistry {
+	public:
+		TextureRegistry( ) = default;
+		~TextureRegistry( ) { Clear( ); }
+
+		TextureRegistry( const TextureRegistry & ) = delete;
+		TextureRegistry &operator=( const TextureRegistry & ) = delete;
+
+		// Takes ownership of the texture. Returns INVALID_TEXTURE_HANDLE if the registry is full.
+		TextureHandle Register( SDL_Texture *texture );
+
+		// Makes every gid in [firstGid, firstGid + count) resolve to the handle.
+		void BindGidRange( uint32_t firstGid, uint32_t count, TextureHandle handle );
+		void BindGid( uint32_t gid, TextureHandle handle ) { BindGidRange( gid, 1, handle ); }
+
+		// Makes the gid resolve to a sub-rect of the texture, e.g. its place on an atlas page.
+		void BindGidRegion( uint32_t gid, TextureHandle handle, const SDL_Rect &region );
+
+		TextureHandle GetHandleForGid( uint32_t gid ) const {
+			return gid < m_gidHandles.size( ) ? m_gidHandles[gid] : INVALID_TEXTURE_HANDLE;
+		}
+
+		// The pixels the gid's image occupies: its region if it was bound to one, otherwise the
+		// whole texture. Only meaningful for gids bound to a valid handle.
+		SDL_Rect GetImageRectForGid( uint32_t gid ) const;
+
+		const TextureEntry &Get( TextureHandle handle ) const { return m_entries[handle]; }
+		size_t GetCount( ) const { return m_entries.size( ); }
+
+		// Approximate GPU memory of all registered textures in bytes, assuming 4 bytes per texel.
+		size_t GetTextureMemory( ) const { return m_textureMemory; }
+
+		// Destroys all textures and forgets every handle.
+		void Clear( );
+
+	private:
+		std::vector<TextureEntry> m_entries;
+		std::vector<TextureHandle> m_gidHandles;
+		// Parallel to m_gidHandles, an empty rect stands for the whole texture.
+		std::vector<SDL_Rect> m_gidRegions;
+		size_t m_textureMemory = 0;
+	};
+}
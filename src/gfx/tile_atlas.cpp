@@ -0,0 +1,143 @@
+#include "tile_atlas.h"
+#include "cube_atlas.h"
+#include "../Profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace SiegePerilous {
+
+	void TileAtlasBuilder::Add( uint32_t gid, SDL_Surface *surface ) {
+		if ( surface ) {
+			m_images.push_back( { gid, surface } );
+		}
+	}
+
+	void TileAtlasBuilder::Clear( ) {
+		for ( const Image &image : m_images ) {
+			SDL_DestroySurface( image.surface );
+		}
+		m_images.clear( );
+	}
+
+	int TileAtlasBuilder::Build( SDL_Renderer *renderer, TextureRegistry &textures ) {
+		SP_PROFILE_SCOPE( "TileAtlasBuilder::Build" );
+		if ( m_images.empty( ) ) {
+			return 0;
+		}
+
+		const SDL_PropertiesID properties = SDL_GetRendererProperties( renderer );
+		const int pageLimit = static_cast< int >( std::min<Sint64>( MAX_PAGE_SIZE, SDL_GetNumberProperty( properties, SDL_PROP_RENDERER_MAX_TEXTURE_SIZE_NUMBER, MAX_PAGE_SIZE ) ) );
+
+		// The packer keeps a one pixel border around the page, every image is padded on all sides.
+		auto fitsOnPage = [pageLimit] ( const SDL_Surface *surface ) {
+			return surface->w + 2 * PADDING <= pageLimit - 2 && surface->h + 2 * PADDING <= pageLimit - 2;
+		};
+
+		// Tall images first, the skyline packer wastes less space that way.
+		std::stable_sort( m_images.begin( ), m_images.end( ), [] ( const Image &a, const Image &b ) {
+			return a.surface->h != b.surface->h ? a.surface->h > b.surface->h : a.surface->w > b.surface->w;
+		} );
+
+		// Size the pages to the images instead of always using the largest texture:
+		// a square with some slack for the packer, rounded up to steps of 256 pixels.
+		double area = 0.0;
+		int largestSide = 0;
+		for ( const Image &image : m_images ) {
+			if ( fitsOnPage( image.surface ) ) {
+				area += static_cast< double >( image.surface->w + 2 * PADDING ) * ( image.surface->h + 2 * PADDING );
+				largestSide = std::max( { largestSide, image.surface->w + 2 * PADDING + 2, image.surface->h + 2 * PADDING + 2 } );
+			}
+		}
+		int pageSize = static_cast< int >( std::ceil( std::sqrt( area * 1.1 ) ) );
+		pageSize = std::max( pageSize, largestSide );
+		pageSize = std::min( ( pageSize + 255 ) / 256 * 256, pageLimit );
+
+		struct Page {
+			RectanglePacker packer;
+			SDL_Surface *surface;
+			int usedHeight;
+		};
+		struct Placement {
+			uint32_t gid;
+			size_t page;
+			SDL_Rect region;
+		};
+		std::vector<Page> pages;
+		std::vector<Placement> placements;
+
+		for ( const Image &image : m_images ) {
+			SDL_Surface *surface = image.surface;
+			const uint16_t paddedWidth = static_cast< uint16_t >( surface->w + 2 * PADDING );
+			const uint16_t paddedHeight = static_cast< uint16_t >( surface->h + 2 * PADDING );
+
+			uint16_t x = 0;
+			uint16_t y = 0;
+			size_t pageIndex = pages.size( );
+			if ( fitsOnPage( surface ) ) {
+				for ( size_t i = 0; i < pages.size( ); ++i ) {
+					if ( pages[i].packer.addRectangle( paddedWidth, paddedHeight, x, y ) ) {
+						pageIndex = i;
+						break;
+					}
+				}
+				if ( pageIndex == pages.size( ) ) {
+					SDL_Surface *pageSurface = SDL_CreateSurface( pageSize, pageSize, SDL_PIXELFORMAT_RGBA32 );
+					if ( pageSurface ) {
+						SDL_FillSurfaceRect( pageSurface, nullptr, 0 );
+						Page &page = pages.emplace_back( Page{ RectanglePacker( pageSize, pageSize ), pageSurface, 0 } );
+						if ( !page.packer.addRectangle( paddedWidth, paddedHeight, x, y ) ) {
+							pageIndex = pages.size( );
+						}
+					} else {
+						std::cerr << "Failed to create tile atlas page! SDL_Error: " << SDL_GetError( ) << std::endl;
+					}
+				}
+			}
+
+			// Too large for a page, or no page could be made: the image keeps a texture of its own.
+			if ( pageIndex >= pages.size( ) ) {
+				SDL_Texture *texture = SDL_CreateTextureFromSurface( renderer, surface );
+				if ( texture ) {
+					textures.BindGid( image.gid, textures.Register( texture ) );
+				} else {
+					std::cerr << "Failed to create texture for tile " << image.gid << "! SDL_Error: " << SDL_GetError( ) << std::endl;
+				}
+				continue;
+			}
+
+			Page &page = pages[pageIndex];
+			SDL_Rect region = { x + PADDING, y + PADDING, surface->w, surface->h };
+			// Copy the pixels as they are, alpha included.
+			SDL_SetSurfaceBlendMode( surface, SDL_BLENDMODE_NONE );
+			SDL_BlitSurface( surface, nullptr, page.surface, &region );
+			page.usedHeight = std::max( page.usedHeight, y + paddedHeight + 1 );
+			placements.push_back( { image.gid, pageIndex, region } );
+		}
+
+		// Pages are only as tall as their lowest image needs.
+		std::vector<TextureHandle> pageHandles( pages.size( ), INVALID_TEXTURE_HANDLE );
+		for ( size_t i = 0; i < pages.size( ); ++i ) {
+			Page &page = pages[i];
+			SDL_Texture *texture = SDL_CreateTexture( renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STATIC, pageSize, page.usedHeight );
+			if ( texture ) {
+				SDL_SetTextureBlendMode( texture, SDL_BLENDMODE_BLEND );
+				SDL_UpdateTexture( texture, nullptr, page.surface->pixels, page.surface->pitch );
+				pageHandles[i] = textures.Register( texture );
+			} else {
+				std::cerr << "Failed to create tile atlas texture! SDL_Error: " << SDL_GetError( ) << std::endl;
+			}
+			SDL_DestroySurface( page.surface );
+		}
+
+		for ( const Placement &placement : placements ) {
+			if ( pageHandles[placement.page] != INVALID_TEXTURE_HANDLE ) {
+				textures.BindGidRegion( placement.gid, pageHandles[placement.page], placement.region );
+			}
+		}
+
+		Clear( );
+		return static_cast< int >( pages.size( ) );
+	}
+}
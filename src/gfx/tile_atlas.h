@@ -0,0 +1,44 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <cstdint>
+#include <vector>
+#include "texture_registry.h"
+
+namespace SiegePerilous {
+
+	// Packs the images of individual tiles into shared pages with the skyline RectanglePacker
+	// from cube_atlas.h. Tiles then draw from sub-rects of a few textures and batch like
+	// spritesheet tiles instead of switching textures for every tile.
+	class TileAtlasBuilder {
+	public:
+		// Upper bound for the side of a page, lowered to what the renderer supports.
+		static constexpr int MAX_PAGE_SIZE = 4096;
+		// Transparent pixels between images, keeps filtering from bleeding neighbours in.
+		static constexpr int PADDING = 1;
+
+		TileAtlasBuilder( ) = default;
+		~TileAtlasBuilder( ) { Clear( ); }
+
+		TileAtlasBuilder( const TileAtlasBuilder & ) = delete;
+		TileAtlasBuilder &operator=( const TileAtlasBuilder & ) = delete;
+
+		// Queues the image of a gid. Takes ownership of the surface.
+		void Add( uint32_t gid, SDL_Surface *surface );
+
+		// Packs every queued image, registers the pages and binds each gid to its region.
+		// Images too large for a page get a texture of their own. Returns the number of pages.
+		int Build( SDL_Renderer *renderer, TextureRegistry &textures );
+
+		// Frees the queued surfaces.
+		void Clear( );
+
+	private:
+		struct Image {
+			uint32_t gid;
+			SDL_Surface *surface;
+		};
+
+		std::vector<Image> m_images;
+	};
+}
@@ -0,0 +1,114 @@
+#include "tile_batcher.h"
+
+namespace SiegePerilous {
+
+	void TileGeometry::AddQuad( SDL_Texture *texture, const SDL_FRect &uv, const SDL_FRect &dest, int quarterTurns, SDL_FlipMode flip ) {
+		const uint32_t quad = static_cast< uint32_t >( vertices.size( ) / 4 );
+		if ( runs.empty( ) || runs.back( ).texture != texture || runs.back( ).quadCount >= TileBatcher::MAX_QUADS_PER_BATCH ) {
+			runs.push_back( { texture, quad, 0 } );
+		}
+		++runs.back( ).quadCount;
+
+		quarterTurns &= 3;
+
+		// Rotating a rect by 90 degrees around its center swaps its extents.
+		SDL_FRect rect = dest;
+		if ( quarterTurns & 1 ) {
+			const float cx = dest.x + dest.w * 0.5f;
+			const float cy = dest.y + dest.h * 0.5f;
+			rect = { cx - dest.h * 0.5f, cy - dest.w * 0.5f, dest.h, dest.w };
+		}
+
+		// Corners in the order top-left, top-right, bottom-right, bottom-left.
+		static constexpr float corners[4][2] = { { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 1.0f, 1.0f }, { 0.0f, 1.0f } };
+		const SDL_FColor white = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+		for ( const auto &corner : corners ) {
+			// The texel that ends up in this corner: undo the rotation first, then the flip.
+			float u = corner[0];
+			float v = corner[1];
+			for ( int turn = 0; turn < quarterTurns; ++turn ) {
+				float t = u;
+				u = v;
+				v = 1.0f - t;
+			}
+			if ( flip & SDL_FLIP_HORIZONTAL ) {
+				u = 1.0f - u;
+			}
+			if ( flip & SDL_FLIP_VERTICAL ) {
+				v = 1.0f - v;
+			}
+
+			SDL_Vertex vertex;
+			vertex.position = { rect.x + corner[0] * rect.w, rect.y + corner[1] * rect.h };
+			vertex.color = white;
+			vertex.tex_coord = { uv.x + u * uv.w, uv.y + v * uv.h };
+			vertices.push_back( vertex );
+		}
+	}
+
+	void TileGeometry::AddRotatedQuad( SDL_Texture *texture, const SDL_FRect &uv, const SDL_FRect &dest, float angle, const SDL_FPoint &pivot, SDL_FlipMode flip ) {
+		AddQuad( texture, uv, dest, 0, flip );
+		if ( angle == 0.0f ) {
+			return;
+		}
+
+		// Y points down, so the usual rotation turns clockwise on screen.
+		const float radians = angle * ( SDL_PI_F / 180.0f );
+		const float c = SDL_cosf( radians );
+		const float s = SDL_sinf( radians );
+		for ( auto vertex = vertices.end( ) - 4; vertex != vertices.end( ); ++vertex ) {
+			const float x = vertex->position.x - pivot.x;
+			const float y = vertex->position.y - pivot.y;
+			vertex->position = { pivot.x + x * c - y * s, pivot.y + x * s + y * c };
+		}
+	}
+
+	void TileBatcher::Begin( SDL_Renderer *renderer ) {
+		m_renderer = renderer;
+		m_pending.Clear( );
+		m_drawCalls = 0;
+		m_quadCount = 0;
+	}
+
+	void TileBatcher::GrowIndices( size_t quads ) {
+		size_t have = m_indices.size( ) / 6;
+		if ( have >= quads ) {
+			return;
+		}
+		m_indices.reserve( quads * 6 );
+		for ( size_t q = have; q < quads; ++q ) {
+			const int base = static_cast< int >( q * 4 );
+			m_indices.push_back( base + 0 );
+			m_indices.push_back( base + 1 );
+			m_indices.push_back( base + 2 );
+			m_indices.push_back( base + 2 );
+			m_indices.push_back( base + 3 );
+			m_indices.push_back( base + 0 );
+		}
+	}
+
+	void TileBatcher::SubmitRuns( const TileGeometry &geometry ) {
+		if ( !m_renderer ) {
+			return;
+		}
+
+		for ( const TileGeometry::Run &run : geometry.runs ) {
+			GrowIndices( run.quadCount );
+			SDL_RenderGeometry( m_renderer, run.texture, geometry.vertices.data( ) + static_cast< size_t >( run.firstQuad ) * 4,
+				static_cast< int >( run.quadCount * 4 ), m_indices.data( ), static_cast< int >( run.quadCount * 6 ) );
+			++m_drawCalls;
+			m_quadCount += static_cast< int >( run.quadCount );
+		}
+	}
+
+	void TileBatcher::Flush( ) {
+		SubmitRuns( m_pending );
+		m_pending.Clear( );
+	}
+
+	void TileBatcher::Submit( const TileGeometry &geometry ) {
+		Flush( );
+		SubmitRuns( geometry );
+	}
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <cstdint>
+#include <vector>
+
+namespace SiegePerilous {
+
+	// Quads recorded ahead of time, grouped in runs that share a texture.
+	// Can be kept around and submitted again as long as nothing in it changed.
+	struct TileGeometry {
+		struct Run {
+			SDL_Texture *texture;
+			uint32_t firstQuad;
+			uint32_t quadCount;
+		};
+
+		std::vector<SDL_Vertex> vertices;
+		std::vector<Run> runs;
+
+		void Clear( ) {
+			vertices.clear( );
+			runs.clear( );
+		}
+
+		// Appends a quad. uv is the source rect in normalized texture coordinates.
+		// quarterTurns rotates the quad clockwise around its center in 90 degree steps,
+		// flip is applied to the texture before the rotation, like SDL_RenderTextureRotated does.
+		void AddQuad( SDL_Texture *texture, const SDL_FRect &uv, const SDL_FRect &dest, int quarterTurns = 0, SDL_FlipMode flip = SDL_FLIP_NONE );
+
+		// Appends a quad rotated clockwise by angle degrees around pivot, e.g. a Tiled object.
+		void AddRotatedQuad( SDL_Texture *texture, const SDL_FRect &uv, const SDL_FRect &dest, float angle, const SDL_FPoint &pivot, SDL_FlipMode flip = SDL_FLIP_NONE );
+
+		size_t GetQuadCount( ) const { return vertices.size( ) / 4; }
+	};
+
+	// Submits every run of quads that share a texture with a single SDL_RenderGeometry call.
+	// Quads are submitted in the order they were added, so the painter's order of
+	// the tile layers is preserved.
+	class TileBatcher {
+	public:
+		// Upper bound for a single SDL_RenderGeometry call.
+		static constexpr int MAX_QUADS_PER_BATCH = 16384;
+
+		void Begin( SDL_Renderer *renderer );
+
+		// Appends a quad to the pending geometry, see TileGeometry::AddQuad.
+		void AddQuad( SDL_Texture *texture, const SDL_FRect &uv, const SDL_FRect &dest, int quarterTurns = 0, SDL_FlipMode flip = SDL_FLIP_NONE ) {
+			m_pending.AddQuad( texture, uv, dest, quarterTurns, flip );
+		}
+
+		// Appends a rotated quad to the pending geometry, see TileGeometry::AddRotatedQuad.
+		void AddRotatedQuad( SDL_Texture *texture, const SDL_FRect &uv, const SDL_FRect &dest, float angle, const SDL_FPoint &pivot, SDL_FlipMode flip = SDL_FLIP_NONE ) {
+			m_pending.AddRotatedQuad( texture, uv, dest, angle, pivot, flip );
+		}
+
+		// Submits the pending quads.
+		void Flush( );
+
+		// Flushes the pending quads and submits recorded geometry after them.
+		void Submit( const TileGeometry &geometry );
+
+		void End( ) { Flush( ); }
+
+		// Number of SDL_RenderGeometry calls issued since the last Begin.
+		int GetDrawCalls( ) const { return m_drawCalls; }
+
+		// Number of quads submitted since the last Begin.
+		int GetQuadCount( ) const { return m_quadCount; }
+
+	private:
+		void GrowIndices( size_t quads );
+		void SubmitRuns( const TileGeometry &geometry );
+
+		SDL_Renderer *m_renderer = nullptr;
+		TileGeometry m_pending;
+		// Shared index pattern (0,1,2, 2,3,0 per quad), only ever grows.
+		std::vector<int> m_indices;
+		int m_drawCalls = 0;
+		int m_quadCount = 0;
+	};
+}
@@ -0,0 +1,619 @@
+#include "tile_renderer.h"
+#include "../Profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace SiegePerilous {
+
+	bool TileRenderer::Resolve( const Tiled::Map &map, uint32_t raw_gid, uint32_t render_gid, TileRenderRecord &record ) const {
+		const Tiled::GidEntry *entry = map.LookupGid( raw_gid & ~ALL_FLIP_FLAGS_MASK );
+		if ( !entry ) {
+			return false;
+		}
+		const Tiled::Tileset *tileset = &map.tilesets[entry->tileset];
+
+		record.dest = { record.cell.x, record.cell.y, static_cast< float >( map.tilewidth ), static_cast< float >( map.tileheight ) };
+		record.angle = 0.0f;
+		record.flip = SDL_FLIP_NONE;
+
+		const TextureHandle handle = m_textures->GetHandleForGid( render_gid );
+		if ( handle == INVALID_TEXTURE_HANDLE ) {
+			return false;
+		}
+		record.texture = handle;
+
+		// Case 1: a tileset made of individual images, every tile has its own image,
+		// either a texture of its own or a region of an atlas page.
+		if ( !tileset->image ) {
+			const SDL_Rect image = m_textures->GetImageRectForGid( render_gid );
+
+			//hmmm i dont remeber why i need to do this only on Y..
+			//dest_rect.x +=  -texture->w + m_map->tilewidth;
+			record.dest.y += -image.h + map.tileheight;
+			record.dest.w = static_cast< float >( image.w );
+			record.dest.h = static_cast< float >( image.h );
+			record.src = { static_cast< float >( image.x ), static_cast< float >( image.y ), static_cast< float >( image.w ), static_cast< float >( image.h ) };
+			record.flags |= TileRenderRecord::TILE_IMAGE;
+			return true;
+		}
+
+		// Case 2: a tile from a spritesheet.
+
+		const uint32_t local_id = render_gid - tileset->firstgid;
+		const int tile_width = tileset->tilewidth.value_or( 0 );
+		const int tile_height = tileset->tileheight.value_or( 0 );
+		const int columns = tileset->columns.value_or( 1 );
+		if ( columns <= 0 || tile_width <= 0 || tile_height <= 0 ) {
+			return false;
+		}
+
+		record.src = {
+			static_cast< float >( ( local_id % columns ) * tile_width ),
+			static_cast< float >( ( local_id / columns ) * tile_height ),
+			static_cast< float >( tile_width ),
+			static_cast< float >( tile_height )
+		};
+		record.flags &= ~TileRenderRecord::TILE_IMAGE;
+
+		// Tiled's diagonal flip is a 90-degree rotation plus a horizontal flip.
+		// The other flags are applied on top of that.
+		int flip = SDL_FLIP_NONE;
+		if ( raw_gid & FLIPPED_DIAGONALLY_FLAG ) {
+			record.angle = 90.0f;
+			flip = SDL_FLIP_HORIZONTAL;
+		}
+		if ( raw_gid & FLIPPED_HORIZONTALLY_FLAG ) {
+			// XOR the flip flag. If it was already set by the diagonal flip, it will be cleared, and vice-versa.
+			flip ^= SDL_FLIP_HORIZONTAL;
+		}
+		if ( raw_gid & FLIPPED_VERTICALLY_FLAG ) {
+			flip ^= SDL_FLIP_VERTICAL;
+		}
+		record.flip = static_cast< uint8_t >( flip );
+		return true;
+	}
+
+	namespace {
+		bool GetBoolProperty( const std::vector<Tiled::Property> &properties, const char *name ) {
+			for ( const Tiled::Property &property : properties ) {
+				if ( property.name == name && std::holds_alternative<bool>( property.value ) ) {
+					return std::get<bool>( property.value );
+				}
+			}
+			return false;
+		}
+	}
+
+	void TileRenderer::Build( Tiled::Map &map, const TextureRegistry &textures ) {
+		SP_PROFILE_SCOPE( "TileRenderer::Build" );
+		Clear( );
+		m_textures = &textures;
+
+		// The largest individual tile image, spritesheets are never drawn whole.
+		for ( uint32_t gid = 0; gid < map.m_gid_index.size( ); ++gid ) {
+			const Tiled::GidEntry &entry = map.m_gid_index[gid];
+			const TextureHandle handle = textures.GetHandleForGid( gid );
+			if ( entry.tileset >= 0 && !map.tilesets[entry.tileset].image && handle != INVALID_TEXTURE_HANDLE ) {
+				const SDL_Rect image = textures.GetImageRectForGid( gid );
+				m_maxImageWidth = std::max( m_maxImageWidth, image.w );
+				m_maxImageHeight = std::max( m_maxImageHeight, image.h );
+			}
+		}
+
+		for ( Tiled::Layer *layerPtr : map.GetLayersOfType( "tilelayer", true, true ) ) {
+			Tiled::Layer &layer = *layerPtr;
+
+			auto addLayerRecords = [this, &layer] ( Tiled::Chunk *mapChunk, int originColumn, int originRow, int width, int height ) -> LayerRecords & {
+				LayerRecords &layerRecords = m_layers.emplace_back( );
+				layerRecords.layer = &layer;
+				layerRecords.mapChunk = mapChunk;
+				layerRecords.originColumn = originColumn;
+				layerRecords.originRow = originRow;
+				layerRecords.resident = mapChunk == nullptr;
+				layerRecords.edited = false;
+				layerRecords.width = width;
+				layerRecords.height = height;
+				layerRecords.overhangColumns = 0;
+				layerRecords.overhangRows = 0;
+				layerRecords.cacheValid = false;
+				layerRecords.visitedTiles = 0;
+				layerRecords.drawnTiles = 0;
+				layerRecords.cached = GetBoolProperty( layer.properties, CACHE_PROPERTY );
+				layerRecords.chunkColumns = ( width + CHUNK_TILES - 1 ) / CHUNK_TILES;
+				layerRecords.chunkRows = ( height + CHUNK_TILES - 1 ) / CHUNK_TILES;
+				if ( layerRecords.cached ) {
+					layerRecords.chunks.resize( static_cast< size_t >( layerRecords.chunkColumns ) * layerRecords.chunkRows );
+				}
+				return layerRecords;
+			};
+
+			// Infinite maps: one set of records per chunk, built once the chunk streams in.
+			if ( layer.chunks && !layer.chunks->empty( ) ) {
+				for ( Tiled::Chunk &chunk : *layer.chunks ) {
+					addLayerRecords( &chunk, chunk.x, chunk.y, chunk.width, chunk.height );
+				}
+				continue;
+			}
+
+			if ( !layer.width.has_value( ) || !layer.height.has_value( ) ) {
+				continue;
+			}
+			BuildRecords( map, addLayerRecords( nullptr, 0, 0, *layer.width, *layer.height ) );
+		}
+
+		m_resolvedRevision = map.m_animation_revision;
+	}
+
+	void TileRenderer::BuildRecords( const Tiled::Map &map, LayerRecords &layerRecords ) {
+		const Tiled::Layer &layer = *layerRecords.layer;
+		const std::vector<uint32_t> &data = layerRecords.mapChunk ? layerRecords.mapChunk->decoded_data : layer.decoded_data;
+		layerRecords.records.clear( );
+		layerRecords.rowStart.clear( );
+		layerRecords.animatedRecords.clear( );
+		layerRecords.rowStart.reserve( layerRecords.height + 1 );
+
+		const int width = layerRecords.width;
+		const int height = layerRecords.height;
+		for ( int y = 0; y < height; ++y ) {
+			layerRecords.rowStart.push_back( static_cast< uint32_t >( layerRecords.records.size( ) ) );
+			for ( int x = 0; x < width; ++x ) {
+				const size_t index = static_cast< size_t >( y ) * width + x;
+				if ( index >= data.size( ) ) {
+					break;
+				}
+				const uint32_t raw_gid = data[index];
+				if ( raw_gid == 0 ) {
+					continue;
+				}
+
+				TileRenderRecord record{};
+				record.raw_gid = raw_gid;
+				record.cell = {
+					static_cast< float >( ( layerRecords.originColumn + x ) * map.tilewidth + layer.offsetx ),
+					static_cast< float >( ( layerRecords.originRow + y ) * map.tileheight + layer.offsety )
+				};
+
+				const uint32_t gid = raw_gid & ~ALL_FLIP_FLAGS_MASK;
+				const uint32_t render_gid = gid < map.m_render_gid.size( ) ? map.m_render_gid[gid] : gid;
+				const bool animated = map.m_active_animations.contains( gid );
+				const bool resolved = Resolve( map, raw_gid, render_gid, record );
+				if ( animated ) {
+					record.flags |= TileRenderRecord::ANIMATED;
+					if ( !resolved ) {
+						record.flags |= TileRenderRecord::UNRESOLVED;
+					}
+					layerRecords.animatedRecords.push_back( static_cast< uint32_t >( layerRecords.records.size( ) ) );
+				}
+
+				if ( resolved || animated ) {
+					layerRecords.records.push_back( record );
+				}
+			}
+		}
+		layerRecords.rowStart.push_back( static_cast< uint32_t >( layerRecords.records.size( ) ) );
+
+		// Individual tile images can be larger than a cell, they grow to the right and upwards.
+		// Animated tiles may switch to a larger frame, so any tile image of the map counts.
+		const bool hasTileImages = std::any_of( layerRecords.records.begin( ), layerRecords.records.end( ), [] ( const TileRenderRecord &record ) {
+			return ( record.flags & ( TileRenderRecord::TILE_IMAGE | TileRenderRecord::ANIMATED ) ) != 0;
+		} );
+		int overhangColumns = 0;
+		int overhangRows = 0;
+		if ( hasTileImages && map.tilewidth > 0 && map.tileheight > 0 ) {
+			overhangColumns = static_cast< int >( std::ceil( std::max( 0, m_maxImageWidth - map.tilewidth ) / static_cast< float >( map.tilewidth ) ) );
+			overhangRows = static_cast< int >( std::ceil( std::max( 0, m_maxImageHeight - map.tileheight ) / static_cast< float >( map.tileheight ) ) );
+		}
+
+		// Chunk textures are sized by the overhang, they have to be made again when it changes.
+		if ( overhangColumns != layerRecords.overhangColumns || overhangRows != layerRecords.overhangRows ) {
+			ReleaseChunks( layerRecords );
+		}
+		layerRecords.overhangColumns = overhangColumns;
+		layerRecords.overhangRows = overhangRows;
+		layerRecords.cacheValid = false;
+	}
+
+	void TileRenderer::SetTile( Tiled::Map &map, Tiled::Layer &layer, int x, int y, uint32_t raw_gid ) {
+		auto it = std::find_if( m_layers.begin( ), m_layers.end( ), [&layer, x, y] ( const LayerRecords &layerRecords ) {
+			return layerRecords.layer == &layer
+				&& x >= layerRecords.originColumn && x < layerRecords.originColumn + layerRecords.width
+				&& y >= layerRecords.originRow && y < layerRecords.originRow + layerRecords.height;
+		} );
+		if ( it == m_layers.end( ) ) {
+			return;
+		}
+
+		LayerRecords &layerRecords = *it;
+		if ( !layerRecords.resident ) {
+			StreamIn( map, layerRecords );
+		}
+
+		std::vector<uint32_t> &data = layerRecords.mapChunk ? layerRecords.mapChunk->decoded_data : layer.decoded_data;
+		const int localX = x - layerRecords.originColumn;
+		const int localY = y - layerRecords.originRow;
+		const size_t index = static_cast< size_t >( localY ) * layerRecords.width + localX;
+		if ( index >= data.size( ) || data[index] == raw_gid ) {
+			return;
+		}
+		data[index] = raw_gid;
+		layerRecords.edited = true;
+
+		BuildRecords( map, layerRecords );
+		if ( layerRecords.cached && !layerRecords.chunks.empty( ) ) {
+			layerRecords.chunks[static_cast< size_t >( localY / CHUNK_TILES ) * layerRecords.chunkColumns + localX / CHUNK_TILES].dirty = true;
+		}
+	}
+
+	void TileRenderer::StreamIn( const Tiled::Map &map, LayerRecords &layerRecords ) {
+		SP_PROFILE_SCOPE( "TileRenderer::StreamIn" );
+		// A chunk that fails to decode stays resident without records, so it is not retried every frame.
+		layerRecords.resident = true;
+		const Tiled::Chunk &chunk = *layerRecords.mapChunk;
+		const size_t tileCount = static_cast< size_t >( std::max( chunk.width, 0 ) ) * static_cast< size_t >( std::max( chunk.height, 0 ) );
+		if ( Tiled::decode_tile_data( *layerRecords.layer, chunk.data, tileCount, layerRecords.mapChunk->decoded_data ) ) {
+			BuildRecords( map, layerRecords );
+		}
+	}
+
+	void TileRenderer::StreamOut( LayerRecords &layerRecords ) {
+		std::vector<uint32_t>( ).swap( layerRecords.mapChunk->decoded_data );
+		std::vector<TileRenderRecord>( ).swap( layerRecords.records );
+		layerRecords.rowStart.clear( );
+		layerRecords.animatedRecords.clear( );
+		layerRecords.geometry.Clear( );
+		layerRecords.cacheValid = false;
+		layerRecords.resident = false;
+		ReleaseChunks( layerRecords );
+	}
+
+	void TileRenderer::InvalidateChunks( ) {
+		for ( LayerRecords &layerRecords : m_layers ) {
+			for ( LayerChunk &chunk : layerRecords.chunks ) {
+				chunk.dirty = true;
+			}
+		}
+	}
+
+	SDL_FRect TileRenderer::GetChunkRect( const Tiled::Map &map, const LayerRecords &layerRecords, int chunkX, int chunkY ) const {
+		const Tiled::Layer &layer = *layerRecords.layer;
+		const int firstColumn = chunkX * CHUNK_TILES;
+		const int firstRow = chunkY * CHUNK_TILES;
+		const int columns = std::min( CHUNK_TILES, layerRecords.width - firstColumn ) + layerRecords.overhangColumns;
+		const int rows = std::min( CHUNK_TILES, layerRecords.height - firstRow ) + layerRecords.overhangRows;
+		return {
+			static_cast< float >( ( layerRecords.originColumn + firstColumn ) * map.tilewidth + layer.offsetx ),
+			static_cast< float >( ( layerRecords.originRow + firstRow - layerRecords.overhangRows ) * map.tileheight + layer.offsety ),
+			static_cast< float >( columns * map.tilewidth ),
+			static_cast< float >( rows * map.tileheight )
+		};
+	}
+
+	bool TileRenderer::UpdateChunks( SDL_Renderer *renderer, const Tiled::Map &map, LayerRecords &layerRecords, const GeometryKey &key ) {
+		bool geometryValid = true;
+		for ( int chunkY = key.firstRow / CHUNK_TILES; chunkY <= key.lastRow / CHUNK_TILES; ++chunkY ) {
+			for ( int chunkX = key.firstColumn / CHUNK_TILES; chunkX <= key.lastColumn / CHUNK_TILES; ++chunkX ) {
+				LayerChunk &chunk = layerRecords.chunks[static_cast< size_t >( chunkY ) * layerRecords.chunkColumns + chunkX];
+				if ( !chunk.texture ) {
+					const SDL_FRect rect = GetChunkRect( map, layerRecords, chunkX, chunkY );
+					chunk.texture = SDL_CreateTexture( renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, static_cast< int >( rect.w ), static_cast< int >( rect.h ) );
+					if ( !chunk.texture ) {
+						std::cerr << "Failed to create tile chunk texture, drawing layer " << layerRecords.layer->name << " uncached: " << SDL_GetError( ) << std::endl;
+						ReleaseChunks( layerRecords );
+						layerRecords.cached = false;
+						return false;
+					}
+					// The chunk holds colors already multiplied by their alpha.
+					SDL_SetTextureBlendMode( chunk.texture, SDL_BLENDMODE_BLEND_PREMULTIPLIED );
+					m_chunkMemory += static_cast< size_t >( chunk.texture->w ) * chunk.texture->h * 4;
+					chunk.dirty = true;
+					geometryValid = false;
+				}
+				if ( chunk.dirty ) {
+					RenderChunk( renderer, map, layerRecords, chunkX, chunkY );
+				}
+			}
+		}
+		return geometryValid;
+	}
+
+	void TileRenderer::RenderChunk( SDL_Renderer *renderer, const Tiled::Map &map, LayerRecords &layerRecords, int chunkX, int chunkY ) {
+		SP_PROFILE_SCOPE( "TileRenderer::RenderChunk" );
+		LayerChunk &chunk = layerRecords.chunks[static_cast< size_t >( chunkY ) * layerRecords.chunkColumns + chunkX];
+		const SDL_FRect rect = GetChunkRect( map, layerRecords, chunkX, chunkY );
+
+		TileGeometry geometry;
+		const int firstColumn = chunkX * CHUNK_TILES;
+		const int lastColumn = std::min( firstColumn + CHUNK_TILES, layerRecords.width ) - 1;
+		const int firstRow = chunkY * CHUNK_TILES;
+		const int lastRow = std::min( firstRow + CHUNK_TILES, layerRecords.height ) - 1;
+		const LayerTransform transform = { { -rect.x, -rect.y }, { 0.0f, 0.0f }, 1.0f };
+		AddRecords( map, layerRecords, firstColumn, lastColumn, firstRow, lastRow, transform, 0, TileRenderRecord::ANIMATED | TileRenderRecord::UNRESOLVED, geometry );
+
+		// Quads still pending belong to the current target.
+		m_batcher.Flush( );
+
+		SDL_Texture *previousTarget = SDL_GetRenderTarget( renderer );
+		Uint8 r, g, b, a;
+		SDL_GetRenderDrawColor( renderer, &r, &g, &b, &a );
+
+		SDL_SetRenderTarget( renderer, chunk.texture );
+		SDL_SetRenderDrawColor( renderer, 0, 0, 0, 0 );
+		SDL_RenderClear( renderer );
+		m_batcher.Submit( geometry );
+
+		SDL_SetRenderTarget( renderer, previousTarget );
+		SDL_SetRenderDrawColor( renderer, r, g, b, a );
+
+		chunk.dirty = false;
+	}
+
+	void TileRenderer::ReleaseChunks( LayerRecords &layerRecords ) {
+		for ( LayerChunk &chunk : layerRecords.chunks ) {
+			if ( chunk.texture ) {
+				m_chunkMemory -= static_cast< size_t >( chunk.texture->w ) * chunk.texture->h * 4;
+				SDL_DestroyTexture( chunk.texture );
+			}
+			chunk = LayerChunk( );
+		}
+	}
+
+	void TileRenderer::Clear( ) {
+		for ( LayerRecords &layerRecords : m_layers ) {
+			ReleaseChunks( layerRecords );
+		}
+		m_layers.clear( );
+		m_textures = nullptr;
+		m_resolvedRevision = 0;
+		m_maxImageWidth = 0;
+		m_maxImageHeight = 0;
+		m_chunkMemory = 0;
+	}
+
+	void TileRenderer::ResolveAnimations( const Tiled::Map &map ) {
+		for ( LayerRecords &layerRecords : m_layers ) {
+			for ( uint32_t index : layerRecords.animatedRecords ) {
+				TileRenderRecord &record = layerRecords.records[index];
+				const uint32_t gid = record.raw_gid & ~ALL_FLIP_FLAGS_MASK;
+				const uint32_t render_gid = gid < map.m_render_gid.size( ) ? map.m_render_gid[gid] : gid;
+				if ( Resolve( map, record.raw_gid, render_gid, record ) ) {
+					record.flags &= ~TileRenderRecord::UNRESOLVED;
+				} else {
+					record.flags |= TileRenderRecord::UNRESOLVED;
+				}
+			}
+		}
+		m_resolvedRevision = map.m_animation_revision;
+	}
+
+
+	TileRenderer::LayerTransform TileRenderer::ComputeLayerTransform( const Tiled::Map &map, const Tiled::Layer &layer, const Camera &camera ) {
+		LayerTransform transform;
+		transform.origin = camera.ConvertWorldToScreen( Camera::ConvertMapToWorld( { 0.0f, 0.0f } ) );
+		transform.scale = camera.GetPixelsPerMeter( ) / Camera::GetMapPixelsPerMeter( );
+
+		// Tiled moves a layer with parallax factor f by ( viewCenter - parallaxOrigin ) * ( 1 - f ).
+		const SDL_FPoint viewCenter = Camera::ConvertWorldToMap( camera.GetCenter( ) );
+		transform.parallax = {
+			static_cast< float >( ( viewCenter.x - map.parallaxoriginx ) * ( 1.0 - layer.parallaxx ) ),
+			static_cast< float >( ( viewCenter.y - map.parallaxoriginy ) * ( 1.0 - layer.parallaxy ) )
+		};
+		return transform;
+	}
+
+	void TileRenderer::Draw( SDL_Renderer *renderer, const Tiled::Map &map, const Camera &camera, std::span<const TileObject> objects ) {
+		SP_PROFILE_SCOPE( "TileRenderer::Draw" );
+		m_batcher.Begin( renderer );
+		m_tilesVisited = 0;
+		m_tilesDrawn = 0;
+
+		// Animated records only change when Update switched at least one frame.
+		if ( map.m_animation_revision != m_resolvedRevision ) {
+			ResolveAnimations( map );
+		}
+
+		const b2AABB viewBounds = camera.GetViewBounds( );
+		// The world is Y-up, so the lower bound is the bottom-left corner of the screen.
+		const SDL_FPoint viewMin = Camera::ConvertWorldToMap( { viewBounds.lowerBound.x, viewBounds.upperBound.y } );
+		const SDL_FPoint viewMax = Camera::ConvertWorldToMap( { viewBounds.upperBound.x, viewBounds.lowerBound.y } );
+
+		for ( LayerRecords &layerRecords : m_layers ) {
+			const Tiled::Layer &layer = *layerRecords.layer;
+			if ( !layer.visible || map.tilewidth <= 0 || map.tileheight <= 0 ) {
+				continue;
+			}
+
+			const LayerTransform transform = ComputeLayerTransform( map, layer, camera );
+
+			// Visible part of these records in cells, grown by how far tile images reach outside their cell.
+			const float left = viewMin.x - transform.parallax.x - static_cast< float >( layer.offsetx );
+			const float right = viewMax.x - transform.parallax.x - static_cast< float >( layer.offsetx );
+			const float top = viewMin.y - transform.parallax.y - static_cast< float >( layer.offsety );
+			const float bottom = viewMax.y - transform.parallax.y - static_cast< float >( layer.offsety );
+
+			const int firstColumn = static_cast< int >( std::floor( left / map.tilewidth ) ) - layerRecords.originColumn - layerRecords.overhangColumns;
+			const int lastColumn = static_cast< int >( std::floor( right / map.tilewidth ) ) - layerRecords.originColumn;
+			const int firstRow = static_cast< int >( std::floor( top / map.tileheight ) ) - layerRecords.originRow;
+			const int lastRow = static_cast< int >( std::floor( bottom / map.tileheight ) ) - layerRecords.originRow + layerRecords.overhangRows;
+
+			// Chunks of infinite maps stream in within one chunk of the view and out beyond two.
+			if ( layerRecords.mapChunk ) {
+				auto isNear = [&] ( int chunks ) {
+					const int marginX = chunks * layerRecords.width;
+					const int marginY = chunks * layerRecords.height;
+					return firstColumn - marginX < layerRecords.width && lastColumn + marginX >= 0
+						&& firstRow - marginY < layerRecords.height && lastRow + marginY >= 0;
+				};
+				if ( !layerRecords.resident && isNear( 1 ) ) {
+					StreamIn( map, layerRecords );
+				} else if ( layerRecords.resident && !layerRecords.edited && !isNear( 2 ) ) {
+					StreamOut( layerRecords );
+				}
+			}
+			if ( layerRecords.records.empty( ) ) {
+				continue;
+			}
+
+			GeometryKey key;
+			key.firstColumn = std::max( 0, firstColumn );
+			key.lastColumn = std::min( layerRecords.width - 1, lastColumn );
+			key.firstRow = std::max( 0, firstRow );
+			key.lastRow = std::min( layerRecords.height - 1, lastRow );
+			if ( key.firstColumn > key.lastColumn || key.firstRow > key.lastRow ) {
+				continue;
+			}
+			key.originX = transform.origin.x;
+			key.originY = transform.origin.y;
+			key.parallaxX = transform.parallax.x;
+			key.parallaxY = transform.parallax.y;
+			key.scale = transform.scale;
+			// Layers without animated tiles do not care about frame changes.
+			key.animationRevision = layerRecords.animatedRecords.empty( ) ? 0 : m_resolvedRevision;
+
+			if ( layerRecords.cached && !UpdateChunks( renderer, map, layerRecords, key ) ) {
+				layerRecords.cacheValid = false;
+			}
+			if ( !layerRecords.cacheValid || layerRecords.cachedKey != key ) {
+				BuildGeometry( map, layerRecords, key, transform );
+			}
+			m_batcher.Submit( layerRecords.geometry );
+			m_tilesVisited += layerRecords.visitedTiles;
+			m_tilesDrawn += layerRecords.drawnTiles;
+		}
+
+		for ( const TileObject &object : objects ) {
+			++m_tilesVisited;
+			if ( AddObject( map, object, camera ) ) {
+				++m_tilesDrawn;
+			}
+		}
+
+		m_batcher.End( );
+	}
+
+	bool TileRenderer::AddObject( const Tiled::Map &map, const TileObject &tileObject, const Camera &camera ) {
+		const Tiled::Object &object = *tileObject.object;
+		if ( !object.gid || !object.visible || !tileObject.layer->visible ) {
+			return false;
+		}
+
+		const uint32_t raw_gid = *object.gid;
+		const uint32_t gid = raw_gid & ~ALL_FLIP_FLAGS_MASK;
+		const uint32_t render_gid = gid < map.m_render_gid.size( ) ? map.m_render_gid[gid] : gid;
+		TileRenderRecord record{ };
+		if ( !Resolve( map, raw_gid, render_gid, record ) ) {
+			return false;
+		}
+
+		// Tile objects are anchored at their bottom-left corner and rotate around it. The tile is
+		// stretched to the object's size, older maps may leave that out.
+		const float width = object.width > 0.0 ? static_cast< float >( object.width ) : record.dest.w;
+		const float height = object.height > 0.0 ? static_cast< float >( object.height ) : record.dest.h;
+		const SDL_FPoint anchor = {
+			static_cast< float >( object.x + tileObject.layer->offsetx ),
+			static_cast< float >( object.y + tileObject.layer->offsety )
+		};
+
+		const LayerTransform transform = ComputeLayerTransform( map, *tileObject.layer, camera );
+		const SDL_FPoint pivot = {
+			transform.origin.x + ( anchor.x + transform.parallax.x ) * transform.scale,
+			transform.origin.y + ( anchor.y + transform.parallax.y ) * transform.scale
+		};
+		const SDL_FRect dest = { pivot.x, pivot.y - height * transform.scale, width * transform.scale, height * transform.scale };
+
+		const TextureEntry &texture = m_textures->Get( record.texture );
+		const float texture_w = static_cast< float >( texture.width );
+		const float texture_h = static_cast< float >( texture.height );
+		const SDL_FRect uv = { record.src.x / texture_w, record.src.y / texture_h, record.src.w / texture_w, record.src.h / texture_h };
+
+		// Objects only flip, the diagonal flag has no meaning for them.
+		int flip = SDL_FLIP_NONE;
+		if ( raw_gid & FLIPPED_HORIZONTALLY_FLAG ) {
+			flip |= SDL_FLIP_HORIZONTAL;
+		}
+		if ( raw_gid & FLIPPED_VERTICALLY_FLAG ) {
+			flip |= SDL_FLIP_VERTICAL;
+		}
+		m_batcher.AddRotatedQuad( texture.texture, uv, dest, static_cast< float >( object.rotation ), pivot, static_cast< SDL_FlipMode >( flip ) );
+		return true;
+	}
+
+	void TileRenderer::BuildGeometry( const Tiled::Map &map, LayerRecords &layerRecords, const GeometryKey &key, const LayerTransform &transform ) {
+		layerRecords.geometry.Clear( );
+		layerRecords.cachedKey = key;
+		layerRecords.cacheValid = true;
+
+		if ( !layerRecords.cached ) {
+			layerRecords.visitedTiles = AddRecords( map, layerRecords, key.firstColumn, key.lastColumn, key.firstRow, key.lastRow, transform, 0, TileRenderRecord::UNRESOLVED, layerRecords.geometry );
+			layerRecords.drawnTiles = static_cast< uint32_t >( layerRecords.geometry.GetQuadCount( ) );
+			return;
+		}
+
+		// The chunk textures first, then the animated tiles they leave out on top.
+		for ( int chunkY = key.firstRow / CHUNK_TILES; chunkY <= key.lastRow / CHUNK_TILES; ++chunkY ) {
+			for ( int chunkX = key.firstColumn / CHUNK_TILES; chunkX <= key.lastColumn / CHUNK_TILES; ++chunkX ) {
+				const LayerChunk &chunk = layerRecords.chunks[static_cast< size_t >( chunkY ) * layerRecords.chunkColumns + chunkX];
+				if ( !chunk.texture ) {
+					continue;
+				}
+				const SDL_FRect rect = GetChunkRect( map, layerRecords, chunkX, chunkY );
+				const SDL_FRect dest = {
+					transform.origin.x + ( rect.x + transform.parallax.x ) * transform.scale,
+					transform.origin.y + ( rect.y + transform.parallax.y ) * transform.scale,
+					rect.w * transform.scale,
+					rect.h * transform.scale
+				};
+				layerRecords.geometry.AddQuad( chunk.texture, { 0.0f, 0.0f, 1.0f, 1.0f }, dest );
+			}
+		}
+		const size_t chunkQuads = layerRecords.geometry.GetQuadCount( );
+		layerRecords.visitedTiles = AddRecords( map, layerRecords, key.firstColumn, key.lastColumn, key.firstRow, key.lastRow, transform, TileRenderRecord::ANIMATED, TileRenderRecord::UNRESOLVED, layerRecords.geometry );
+		layerRecords.drawnTiles = static_cast< uint32_t >( layerRecords.geometry.GetQuadCount( ) - chunkQuads );
+	}
+
+	uint32_t TileRenderer::AddRecords( const Tiled::Map &map, const LayerRecords &layerRecords, int firstColumn, int lastColumn, int firstRow, int lastRow,
+		const LayerTransform &transform, uint8_t requiredFlags, uint8_t rejectedFlags, TileGeometry &geometry ) const {
+		const Tiled::Layer &layer = *layerRecords.layer;
+
+		// Cell positions are exact multiples of the tile size, half a pixel is enough slack.
+		const float firstCellX = static_cast< float >( ( layerRecords.originColumn + firstColumn ) * map.tilewidth + layer.offsetx ) - 0.5f;
+		const float endCellX = static_cast< float >( ( layerRecords.originColumn + lastColumn + 1 ) * map.tilewidth + layer.offsetx ) - 0.5f;
+
+		uint32_t visited = 0;
+
+		for ( int row = firstRow; row <= lastRow; ++row ) {
+			auto rowBegin = layerRecords.records.begin( ) + layerRecords.rowStart[row];
+			auto rowEnd = layerRecords.records.begin( ) + layerRecords.rowStart[row + 1];
+			auto it = std::lower_bound( rowBegin, rowEnd, firstCellX, [] ( const TileRenderRecord &record, float x ) {
+				return record.cell.x < x;
+			} );
+
+			for ( ; it != rowEnd && it->cell.x < endCellX; ++it ) {
+				const TileRenderRecord &record = *it;
+				++visited;
+				if ( ( record.flags & requiredFlags ) != requiredFlags || ( record.flags & rejectedFlags ) ) {
+					continue;
+				}
+
+				const TextureEntry &texture = m_textures->Get( record.texture );
+				const float texture_w = static_cast< float >( texture.width );
+				const float texture_h = static_cast< float >( texture.height );
+				const SDL_FRect uv = {
+					record.src.x / texture_w,
+					record.src.y / texture_h,
+					record.src.w / texture_w,
+					record.src.h / texture_h
+				};
+				const SDL_FRect dest = {
+					transform.origin.x + ( record.dest.x + transform.parallax.x ) * transform.scale,
+					transform.origin.y + ( record.dest.y + transform.parallax.y ) * transform.scale,
+					record.dest.w * transform.scale,
+					record.dest.h * transform.scale
+				};
+				geometry.AddQuad( texture.texture, uv, dest, static_cast< int >( record.angle / 90.0f ), static_cast< SDL_FlipMode >( record.flip ) );
+			}
+		}
+		return visited;
+	}
+}
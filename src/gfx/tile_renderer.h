@@ -0,0 +1,207 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include "../tiled_data.h"
+#include "tile_batcher.h"
+#include "texture_registry.h"
+#include "../b2_sdl_draw.h"
+
+namespace SiegePerilous {
+
+	// Tiled stores the tile transformation in the upper bits of every GID.
+	constexpr uint32_t FLIPPED_HORIZONTALLY_FLAG = 0x80000000;
+	constexpr uint32_t FLIPPED_VERTICALLY_FLAG = 0x40000000;
+	constexpr uint32_t FLIPPED_DIAGONALLY_FLAG = 0x20000000;
+	constexpr uint32_t ALL_FLIP_FLAGS_MASK = ( FLIPPED_HORIZONTALLY_FLAG | FLIPPED_VERTICALLY_FLAG | FLIPPED_DIAGONALLY_FLAG );
+
+	// A tile that has been fully decoded at load time: which texture to use,
+	// which part of it, where it goes and how it is rotated/flipped.
+	struct TileRenderRecord {
+		enum Flags : uint8_t {
+			NONE = 0,
+			TILE_IMAGE = 1 << 0,		// individual tile image, may be larger than a cell
+			ANIMATED = 1 << 1,		// base tile of an animation, re-resolved when a frame changes
+			UNRESOLVED = 1 << 2,	// the current frame has no texture, skipped while drawing
+		};
+
+		SDL_FRect src;			// source rect inside the texture
+		SDL_FRect dest;			// destination rect in map pixels, layer offset applied
+		SDL_FPoint cell;		// top-left corner of the map cell this tile sits in
+		float angle;			// rotation in degrees
+		uint32_t raw_gid;		// gid including the flip flags
+		TextureHandle texture;	// handle in the TextureRegistry the records were built with
+		uint8_t flip;			// SDL_FlipMode
+		uint8_t flags;			// TileRenderRecord::Flags
+	};
+
+	// An object of an object layer, drawn if it is a tile object (Object::gid is set).
+	struct TileObject {
+		const Tiled::Layer *layer;
+		const Tiled::Object *object;
+	};
+
+	// Turns the tile layers of a map into flat arrays of render records once,
+	// so drawing a frame only has to walk those arrays.
+	//
+	// Infinite maps keep their tile data in chunks. Those are decoded when they come
+	// near the view and dropped again once they are far away.
+	//
+	// Layers with the bool property CACHE_PROPERTY set are pre-rendered in chunks of
+	// CHUNK_TILES x CHUNK_TILES cells into target textures, a frame then only draws the
+	// visible chunk textures. Animated tiles are left out of the chunks and drawn on top.
+	class TileRenderer {
+	public:
+		static constexpr int CHUNK_TILES = 32;
+		static constexpr const char *CACHE_PROPERTY = "cached";
+
+		TileRenderer( ) = default;
+		~TileRenderer( ) { Clear( ); }
+
+		TileRenderer( const TileRenderer & ) = delete;
+		TileRenderer &operator=( const TileRenderer & ) = delete;
+
+		// Builds the records for every visible tile layer of the map. Every gid resolves to
+		// its texture through the registry, which must outlive the renderer's records.
+		void Build( Tiled::Map &map, const TextureRegistry &textures );
+
+		// Drops all records and destroys the chunk textures.
+		void Clear( );
+
+		// Changes a cell of a tile layer and updates the records of that layer.
+		// Only the cached chunk that holds the cell is rendered again. Edited chunks of
+		// infinite maps stay decoded, their source data does not hold the edit.
+		void SetTile( Tiled::Map &map, Tiled::Layer &layer, int x, int y, uint32_t raw_gid );
+
+		// Marks every chunk for re-rendering, e.g. after the renderer lost its target textures.
+		void InvalidateChunks( );
+
+		// Approximate memory of the chunk textures in bytes.
+		size_t GetChunkMemory( ) const { return m_chunkMemory; }
+
+		// Submits the tiles the camera can see through the batcher, one draw call per run
+		// of tiles sharing a texture. The tile objects in objects are drawn on top, in order;
+		// the caller culls them.
+		void Draw( SDL_Renderer *renderer, const Tiled::Map &map, const Camera &camera, std::span<const TileObject> objects = { } );
+
+		const TileBatcher &GetBatcher( ) const { return m_batcher; }
+
+		// Records the last Draw walked in the visible cell ranges, and how many of them became quads.
+		uint32_t GetTilesVisited( ) const { return m_tilesVisited; }
+		uint32_t GetTilesDrawn( ) const { return m_tilesDrawn; }
+
+	private:
+		// Everything the geometry of a layer depends on. While it stays the same the
+		// geometry from the previous frame is submitted again.
+		struct GeometryKey {
+			int firstColumn = 0;
+			int lastColumn = -1;
+			int firstRow = 0;
+			int lastRow = -1;
+			float originX = 0.0f;
+			float originY = 0.0f;
+			float parallaxX = 0.0f;
+			float parallaxY = 0.0f;
+			float scale = 0.0f;
+			uint32_t animationRevision = 0;
+
+			bool operator==( const GeometryKey & ) const = default;
+		};
+
+		struct LayerChunk {
+			SDL_Texture *texture = nullptr;
+			bool dirty = true;
+		};
+
+		struct LayerRecords {
+			const Tiled::Layer *layer;
+			// The chunk of an infinite map these records were made from, nullptr for regular layers.
+			Tiled::Chunk *mapChunk;
+			// Cell of the layer the records start at, non-zero for chunks only.
+			int originColumn;
+			int originRow;
+			// Whether mapChunk is decoded and has records.
+			bool resident;
+			bool edited;
+			int width;
+			int height;
+			// Records are stored row by row, records of row y are [rowStart[y], rowStart[y + 1]).
+			std::vector<TileRenderRecord> records;
+			std::vector<uint32_t> rowStart;
+			// How many cells the largest tile image reaches past its own cell, to the right and upwards.
+			int overhangColumns;
+			int overhangRows;
+			// Indices of the ANIMATED records.
+			std::vector<uint32_t> animatedRecords;
+			// Quads of the visible records, valid while cachedKey matches.
+			TileGeometry geometry;
+			GeometryKey cachedKey;
+			bool cacheValid;
+			// Records the geometry walked and the tile quads it holds, chunk quads not counted.
+			uint32_t visitedTiles;
+			uint32_t drawnTiles;
+			// Chunk textures, row by row, only used if the layer is cached.
+			bool cached;
+			int chunkColumns;
+			int chunkRows;
+			std::vector<LayerChunk> chunks;
+		};
+
+		// Maps a layer's map pixels to screen pixels: screen = origin + ( p + parallax ) * scale.
+		struct LayerTransform {
+			SDL_FPoint origin;
+			SDL_FPoint parallax;
+			float scale;
+		};
+
+		static LayerTransform ComputeLayerTransform( const Tiled::Map &map, const Tiled::Layer &layer, const Camera &camera );
+
+		// Fills texture, src, dest, angle and flip of the record for the given gid.
+		// Returns false if the gid has no texture to draw with.
+		bool Resolve( const Tiled::Map &map, uint32_t raw_gid, uint32_t render_gid, TileRenderRecord &record ) const;
+
+		// (Re)creates the records of a layer from its decoded data.
+		void BuildRecords( const Tiled::Map &map, LayerRecords &layerRecords );
+
+		// Decodes a chunk of an infinite map and builds its records, or drops both again.
+		void StreamIn( const Tiled::Map &map, LayerRecords &layerRecords );
+		void StreamOut( LayerRecords &layerRecords );
+
+		// Map pixel rect a chunk texture covers, including the overhang of its tile images.
+		SDL_FRect GetChunkRect( const Tiled::Map &map, const LayerRecords &layerRecords, int chunkX, int chunkY ) const;
+
+		// Creates and renders the visible chunks that are missing or dirty.
+		// Returns false if a new chunk texture was created, the layer geometry is stale then.
+		bool UpdateChunks( SDL_Renderer *renderer, const Tiled::Map &map, LayerRecords &layerRecords, const GeometryKey &key );
+		void RenderChunk( SDL_Renderer *renderer, const Tiled::Map &map, LayerRecords &layerRecords, int chunkX, int chunkY );
+		void ReleaseChunks( LayerRecords &layerRecords );
+
+		// Adds the quad of a tile object to the batcher, returns false if it has nothing to draw.
+		bool AddObject( const Tiled::Map &map, const TileObject &tileObject, const Camera &camera );
+
+		// Re-resolves the animated records against Map::m_render_gid.
+		void ResolveAnimations( const Tiled::Map &map );
+
+		// Records the quads of the cells in the key's range into the layer's geometry.
+		void BuildGeometry( const Tiled::Map &map, LayerRecords &layerRecords, const GeometryKey &key, const LayerTransform &transform );
+
+		// Adds the records of the cell range that have all requiredFlags and none of rejectedFlags.
+		// Returns the number of records walked.
+		uint32_t AddRecords( const Tiled::Map &map, const LayerRecords &layerRecords, int firstColumn, int lastColumn, int firstRow, int lastRow,
+			const LayerTransform &transform, uint8_t requiredFlags, uint8_t rejectedFlags, TileGeometry &geometry ) const;
+
+		std::vector<LayerRecords> m_layers;
+		// Map::m_animation_revision the animated records were last resolved against.
+		uint32_t m_resolvedRevision = 0;
+		const TextureRegistry *m_textures = nullptr;
+		TileBatcher m_batcher;
+		// The largest individual tile image, sets the overhang of layers that use tile images.
+		int m_maxImageWidth = 0;
+		int m_maxImageHeight = 0;
+		size_t m_chunkMemory = 0;
+		uint32_t m_tilesVisited = 0;
+		uint32_t m_tilesDrawn = 0;
+	};
+}
@@ -64,7 +64,7 @@ typedef char16_t UnicodeChar;
 	#define __vectorcall
 #endif
 
-#ifdef ANDROID
+#if defined(ANDROID) || defined(__aarch64__) || defined(_M_ARM64)
 	#define SIMD SIMD_NEON
 #else
 	#define SIMD SIMD_SSE
@@ -7,6 +7,8 @@
 #include "tiled_data.h"
 #include "World.h"
 #include "FileSystem.h"
+#include "JobSystem.h"
+#include "Profiler.h"
 
 static SDL_Window *window		= nullptr;
 static SDL_Renderer *renderer	= nullptr;
@@ -15,16 +17,15 @@ static std::string config_path = "../../../config.json";
 
 static SiegePerilous::WorldState worldState;
 
+// Set from the config or --headless, there is no window, renderer or audio then.
+static bool headless = false;
+
 static unsigned int WINDOW_SIZE_X = 1920;
 static unsigned int WINDOW_SIZE_Y = 1080;
 
 SDL_AppResult SDL_AppInit( void **appstate, int argc, char **argv ) {
 	SDL_SetHint( SDL_HINT_MAIN_CALLBACK_RATE, "60" );
-
-	if (!SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO)) {
-		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Couldn't initialize SDL: %s", SDL_GetError());
-		return SDL_APP_FAILURE;
-	}
+	SP_PROFILE_THREAD( "Main" );
 
 	//////////////////////////////////////////////////////////////////////////
 	//Load config
@@ -45,8 +46,52 @@ SDL_AppResult SDL_AppInit( void **appstate, int argc, char **argv ) {
 
 	fileSystem->Init(fileSystemConfig.basePath,fileSystemConfig.savePath,
 					fileSystemConfig.mainGameName,fileSystemConfig.baseGameName );
+
+	JobSystemConfig jobSystemConfig;
+	err = glz::read < glz::opts{ .error_on_unknown_keys = false } > ( jobSystemConfig, std::string_view( config_buffer, config_file_size ) );
+	jobSystem->Init( jobSystemConfig.workerCount );
+
+	SiegePerilous::SimulationConfig simulationConfig;
+	err = glz::read < glz::opts{ .error_on_unknown_keys = false } > ( simulationConfig, std::string_view( config_buffer, config_file_size ) );
+	SDL_free( config_buffer );
+
+	// --headless [--ticks N] overrides the config.
+	// --benchmark-spatial N compares the spatial indices for N entities on the map and quits.
+	int benchmarkEntities = 0;
+	for ( int arg = 1; arg < argc; ++arg ) {
+		if ( SDL_strcmp( argv[arg], "--headless" ) == 0 ) {
+			simulationConfig.headless = true;
+		} else if ( SDL_strcmp( argv[arg], "--ticks" ) == 0 && arg + 1 < argc ) {
+			simulationConfig.headlessTicks = SDL_atoi( argv[++arg] );
+		} else if ( SDL_strcmp( argv[arg], "--benchmark-spatial" ) == 0 && arg + 1 < argc ) {
+			benchmarkEntities = SDL_atoi( argv[++arg] );
+			simulationConfig.headless = true;
+		}
+	}
+	headless = simulationConfig.headless;
 	//////////////////////////////////////////////////////////////////////////
 
+	if ( !SDL_Init( headless ? 0 : SDL_INIT_VIDEO | SDL_INIT_AUDIO ) ) {
+		SDL_LogError( SDL_LOG_CATEGORY_APPLICATION, "Couldn't initialize SDL: %s", SDL_GetError( ) );
+		return SDL_APP_FAILURE;
+	}
+
+	if ( headless ) {
+		// No window, renderer or audio: simulate the requested ticks and quit.
+		if ( !worldState.Initialise( ) ) {
+			SDL_LogError( SDL_LOG_CATEGORY_APPLICATION, "Couldn't initialise the world." );
+			return SDL_APP_FAILURE;
+		}
+		if ( benchmarkEntities > 0 ) {
+			worldState.RunSpatialBenchmark( benchmarkEntities );
+			return SDL_APP_SUCCESS;
+		}
+		worldState.Start( );
+		worldState.RunHeadless( simulationConfig.headlessTicks );
+		SP_PROFILE_WRITE_TRACE( "headless_trace.json" );
+		return SDL_APP_SUCCESS;
+	}
+
 	SDL_AudioDeviceID *devices;
 	SDL_AudioSpec outspec;
 	SDL_AudioSpec inspec;
@@ -126,13 +171,17 @@ SDL_AppResult SDL_AppInit( void **appstate, int argc, char **argv ) {
 	}
 
 	worldState.SetRenderer( renderer );
-	worldState.Initialise( );
+	if ( !worldState.Initialise( ) ) {
+		SDL_LogError( SDL_LOG_CATEGORY_APPLICATION, "Couldn't initialise the world." );
+		return SDL_APP_FAILURE;
+	}
 	worldState.Start( );
 
 	return SDL_APP_CONTINUE;
 }
 
 SDL_AppResult SDL_AppIterate( void *appstate ) {
+	SP_PROFILE_SCOPE( "Frame" );
 	worldState.Update( );
 
 	Uint64 ticks = SDL_GetTicks( );
@@ -144,7 +193,10 @@ SDL_AppResult SDL_AppIterate( void *appstate ) {
 
 	worldState.Draw( );
 
-	SDL_RenderPresent( renderer );
+	{
+		SP_PROFILE_SCOPE( "Present" );
+		SDL_RenderPresent( renderer );
+	}
 
 	while ( SDL_GetAudioStreamAvailable( worldState.audioState.stream_in ) > 0 ) {
 		Uint8 buf[1024];
@@ -169,13 +221,30 @@ SDL_AppResult SDL_AppEvent( void *appstate, SDL_Event *event ) {
 	if ( event->type == SDL_EVENT_WINDOW_RESIZED ) {
 		worldState.GetCamera( ).UpdateRenderer( renderer );
 	}
+	if ( event->type == SDL_EVENT_RENDER_TARGETS_RESET ) {
+		// Target textures lost their contents, the cached tile chunks have to be drawn again.
+		worldState.GetTileRenderer( ).InvalidateChunks( );
+	}
 	if ( event->type == SDL_EVENT_QUIT ) {
 		worldState.Stop( );
 	} else if ( event->type == SDL_EVENT_KEY_DOWN ) {
 		if ( event->key.key == SDLK_ESCAPE ) {
 			worldState.Stop( );
+		} else if ( event->key.key == SDLK_F3 ) {
+			worldState.GetFrameStats( ).Toggle( );
+		} else if ( event->key.key == SDLK_F9 ) {
+			// Dumps the recorded zones, open the file in chrome://tracing or Perfetto.
+			SP_PROFILE_WRITE_TRACE( "profile_trace.json" );
 		}
 	} else if ( event->type == SDL_EVENT_MOUSE_BUTTON_DOWN ) {
+		if ( event->button.button == SDL_BUTTON_RIGHT ) {
+			// Events come in window coordinates, the camera works in render coordinates.
+			SDL_FPoint point;
+			SDL_RenderCoordinatesFromWindow( renderer, event->button.x, event->button.y, &point.x, &point.y );
+			if ( const Tiled::Object *object = worldState.PickObject( point ) ) {
+				std::cout << "Picked object " << object->id << " '" << object->name << "' (" << object->type << ")" << std::endl;
+			}
+		}
 		if ( event->button.button == 1 ) {
 			SDL_PauseAudioStreamDevice( worldState.audioState.stream_out );
 			SDL_FlushAudioStream( worldState.audioState.stream_out );
@@ -192,14 +261,17 @@ SDL_AppResult SDL_AppEvent( void *appstate, SDL_Event *event ) {
 }
 
 void SDL_AppQuit( void *appstate, SDL_AppResult result ) {
-	const SDL_AudioDeviceID devid_in = SDL_GetAudioStreamDevice( worldState.audioState.stream_in );
-	const SDL_AudioDeviceID devid_out = SDL_GetAudioStreamDevice( worldState.audioState.stream_out );
-	SDL_CloseAudioDevice( devid_in );
-	SDL_CloseAudioDevice( devid_out );
-	SDL_DestroyAudioStream( worldState.audioState.stream_in );
-	SDL_DestroyAudioStream( worldState.audioState.stream_out );
-	SDL_DestroyRenderer( renderer );
-	SDL_DestroyWindow( window );
+	if ( !headless ) {
+		const SDL_AudioDeviceID devid_in = SDL_GetAudioStreamDevice( worldState.audioState.stream_in );
+		const SDL_AudioDeviceID devid_out = SDL_GetAudioStreamDevice( worldState.audioState.stream_out );
+		SDL_CloseAudioDevice( devid_in );
+		SDL_CloseAudioDevice( devid_out );
+		SDL_DestroyAudioStream( worldState.audioState.stream_in );
+		SDL_DestroyAudioStream( worldState.audioState.stream_out );
+		SDL_DestroyRenderer( renderer );
+		SDL_DestroyWindow( window );
+	}
 	worldState.Shutdown( );
+	jobSystem->Shutdown( );
 	SDL_Quit( );
 }
\ No newline at end of file
@@ -5,10 +5,14 @@
 #include <vector>
 #include <optional>
 #include <variant>
+#include <string_view>
 #include <memory>
 
 namespace Tiled {
 
+	// load_map_with_deps caches maps as BEVE of these structs. Any change to a cached struct or
+	// its meta needs MAP_CACHE_SCHEMA in tiled_data_loader.cpp bumped, or old caches misread.
+
 	// Forward declarations for recursive structures
 	struct Layer;
 
@@ -66,6 +70,10 @@ namespace Tiled {
 		int x{};
 		int y{};
 
+		// Not part of the JSON. Infinite maps decode their chunks on demand, this stays
+		// empty while the chunk is not streamed in.
+		std::vector<uint32_t> decoded_data{};
+
 		struct glaze {
 			using T = Chunk;
 			static constexpr auto value = glz::object( "data", &T::data, "height", &T::height, "width", &T::width, "x", &T::x, "y", &T::y );
@@ -208,10 +216,12 @@ namespace Tiled {
 		};
 	};
 
+	// Cached, see the note at the top.
 	struct Layer {
 		std::optional<std::vector<Chunk>> chunks{};
 		std::optional<std::string> class_property{};
 		std::optional<std::string> compression{};
+		// Consumed by load_map_with_deps: empty once the map is loaded, the gids are in decoded_data.
 		std::optional<std::variant<std::vector<uint32_t>, std::string>> data{};
 		std::string draworder = "topdown";
 		std::optional<std::string> encoding{};
@@ -300,6 +310,7 @@ namespace Tiled {
 		};
 	};
 
+	// Cached, see the note at the top.
 	struct Tileset {
 		// Fields populated from the map file
 		int firstgid{};
@@ -392,6 +403,13 @@ namespace Tiled {
 		double time_accumulator_ms = 0.0;
 	};
 
+	// Where a gid lives: the index of its tileset in Map::tilesets and its local tile id.
+	struct GidEntry {
+		int32_t tileset = -1;
+		uint32_t local_id = 0;
+	};
+
+	// Cached, see the note at the top. The runtime extras are not.
 	struct Map {
 		std::optional<std::string> backgroundcolor{};
 		std::optional<std::string> class_property{};
@@ -422,6 +440,13 @@ namespace Tiled {
 		std::map<uint32_t, AnimationDefinition> m_animation_definitions;
 		// Maps a base GID to its currently active state.
 		std::map<uint32_t, ActiveAnimationState> m_active_animations;
+		// Dense gid -> tileset table covering every gid of every tileset, see BuildGidIndex.
+		std::vector<GidEntry> m_gid_index;
+		// Dense gid -> gid to draw. Identity except for animated base gids, which point at the
+		// gid of their current frame. Rewritten by UpdateRenderGid whenever a frame changes.
+		std::vector<uint32_t> m_render_gid;
+		// Bumped every update in which at least one animation switched frames.
+		uint32_t m_animation_revision = 0;
 		//////////////////////////////////////////////////////////////////////////
 
 		struct glaze {
@@ -455,10 +480,50 @@ namespace Tiled {
 
 		std::vector<Layer *> GetAllLayersOfType( const std::string &type, bool resolveGroup );
 		std::vector<Layer *> GetLayersOfType( const std::string &type, const bool visible, const bool resolveGroup );
+
+		// (Re)builds m_gid_index from the tilesets. Called by load_map_with_deps once the
+		// external tilesets are merged.
+		void BuildGidIndex( );
+
+		// Points the base gid of the animation at the gid of its current frame in m_render_gid.
+		void UpdateRenderGid( const ActiveAnimationState &state );
+
+		// Returns the tileset entry of a gid (flip flags stripped), or nullptr if no tileset owns it.
+		const GidEntry *LookupGid( uint32_t gid ) const {
+			if ( gid >= m_gid_index.size( ) || m_gid_index[gid].tileset < 0 ) {
+				return nullptr;
+			}
+			return &m_gid_index[gid];
+		}
 	};
 	
 	// Loads a Tiled map and recursively resolves its external tilesets.
+	// The resolved map is cached as BEVE under "cache/" in the save path; later loads read that
+	// instead of the JSON while the map and its tilesets keep the timestamps they had.
 	std::optional<Tiled::Map> load_map_with_deps( const std::string &map_path );
 
+	// Decompresses source into target, which has exactly the size of the uncompressed data.
+	// Returns false on corrupt data or if the data does not fill target exactly.
+	using Decompressor = bool ( * )( const uint8_t *source, size_t source_size, uint8_t *target, size_t target_size );
+
+	// Sets the codec decode_tile_data uses for layers whose compression is the given name,
+	// replacing an earlier one. "zlib", "gzip" and "zstd" are built in. Register codecs before
+	// loading maps, lookups from the decoding jobs are not synchronised with this.
+	void register_decompressor( const std::string &compression, Decompressor decompressor );
+
+	// The codec for a compression name, nullptr if there is none.
+	Decompressor find_decompressor( std::string_view compression );
+
+	// Decodes the "data" of a layer or of one of its chunks into gids, using the layer's
+	// encoding and compression. tile_count is width * height of the layer or chunk, encoded data
+	// is decoded straight into decoded sized for it. Returns false, with decoded cleared, if the
+	// encoding is not base64 or CSV, or the data could not be decoded or does not hold exactly
+	// tile_count gids.
+	bool decode_tile_data( const Layer &layer, const std::variant<std::vector<uint32_t>, std::string> &data, size_t tile_count, std::vector<uint32_t> &decoded );
+
+	// Same, but moves CSV gids into decoded instead of copying them, for data nobody reads again.
+	// Chunks stay on the copying overload, they are decoded again every time they stream in.
+	bool decode_tile_data( const Layer &layer, std::variant<std::vector<uint32_t>, std::string> &&data, size_t tile_count, std::vector<uint32_t> &decoded );
+
 
 } // namespace Tiled
\ No newline at end of file
@@ -2,55 +2,345 @@
 #include <string>
 #include <filesystem>
 #include <vector>
+#include <algorithm>
+#include <memory>
+#include <string_view>
+#include <utility>
 #include <SDL3/SDL.h>
 #include <SDL3/SDL_assert.h>
 #include "tiled_data.h"
 #include <zlib.h>
+#include <zstd.h>
 #include "FileSystem.h"
+#include "Profiler.h"
+#include "JobSystem.h"
+#include "Base64.h"
 
 namespace Tiled {
 
-	bool decompress_zlib( const std::string &compressed_data, std::vector<unsigned char> &decompressed_data ) {
-		z_stream stream;
-		stream.zalloc = Z_NULL;
-		stream.zfree = Z_NULL;
-		stream.opaque = Z_NULL;
-		stream.avail_in = compressed_data.size( );
-		stream.next_in = ( Bytef * ) compressed_data.data( );
-
-		// Use inflateInit2 with a windowBits of 15+32 for automatic zlib/gzip header detection.
-		if ( inflateInit2( &stream, 15 + 32 ) != Z_OK ) {
-			return false;
-		}
-
-		int ret;
-		const size_t CHUNK = 32768;
-		unsigned char outbuffer[CHUNK];
-
-		do {
-			stream.avail_out = CHUNK;
-			stream.next_out = ( Bytef * ) outbuffer;
-			ret = inflate( &stream, Z_NO_FLUSH );
-
-			switch ( ret ) {
-			case Z_NEED_DICT:
-			case Z_DATA_ERROR:
-			case Z_MEM_ERROR:
-				inflateEnd( &stream );
+	namespace {
+		// Inflates zlib or gzip data in one go, the header tells which.
+		bool inflate_zlib( const uint8_t *source, size_t source_size, uint8_t *target, size_t target_size ) {
+			z_stream stream{ };
+			stream.next_in = const_cast< Bytef * >( source );
+			stream.avail_in = static_cast< uInt >( source_size );
+			// zlib cannot finish a stream without output space, an empty target gets a spare byte
+			// that total_out then has to leave unused.
+			unsigned char spare;
+			stream.next_out = target_size > 0 ? target : &spare;
+			stream.avail_out = target_size > 0 ? static_cast< uInt >( target_size ) : 1;
+
+			// Use inflateInit2 with a windowBits of 15+32 for automatic zlib/gzip header detection.
+			if ( inflateInit2( &stream, 15 + 32 ) != Z_OK ) {
 				return false;
 			}
+			const int ret = inflate( &stream, Z_FINISH );
+			const bool complete = ret == Z_STREAM_END && stream.total_out == target_size;
+			inflateEnd( &stream );
+			return complete;
+		}
+
+		bool decompress_zstd( const uint8_t *source, size_t source_size, uint8_t *target, size_t target_size ) {
+			// A context per thread, chunks of infinite maps decode one after another on the same ones.
+			thread_local std::unique_ptr<ZSTD_DCtx, size_t ( * )( ZSTD_DCtx * )> context( ZSTD_createDCtx( ), ZSTD_freeDCtx );
+			if ( !context ) {
+				return false;
+			}
+			const size_t written = ZSTD_decompressDCtx( context.get( ), target, target_size, source, source_size );
+			return !ZSTD_isError( written ) && written == target_size;
+		}
+
+		struct DecompressorEntry {
+			std::string compression;
+			Decompressor decompressor;
+		};
+
+		std::vector<DecompressorEntry> &get_decompressors( ) {
+			static std::vector<DecompressorEntry> decompressors = {
+				{ "zlib", inflate_zlib },
+				{ "gzip", inflate_zlib },
+				{ "zstd", decompress_zstd },
+			};
+			return decompressors;
+		}
+
+		bool check_gid_count( const Layer &layer, size_t gid_count, size_t tile_count ) {
+			if ( gid_count != tile_count ) {
+				std::cerr << "Error: Layer '" << layer.name << "' holds " << gid_count << " gids, expected " << tile_count << "." << std::endl;
+				return false;
+			}
+			return true;
+		}
+
+		// Decodes base64 tile data, compressed or not, straight into decoded. decoded is only
+		// resized once the payload is known to hold tile_count gids; on failure it holds garbage
+		// and decode_tile_data clears it.
+		bool decode_base64_tile_data( const Layer &layer, const std::string &encoded_data, size_t tile_count, std::vector<uint32_t> &decoded ) {
+			if ( layer.encoding != "base64" ) {
+				std::cerr << "Error: Unsupported encoding '" << layer.encoding.value_or( "" ) << "' for layer '" << layer.name << "'." << std::endl;
+				return false;
+			}
+
+			const size_t byte_count = tile_count * sizeof( uint32_t );
+			if ( !layer.compression || layer.compression->empty( ) ) {
+				// Uncompressed, the base64 payload is the gids themselves.
+				if ( Base64::GetDecodedSize( encoded_data ) != byte_count ) {
+					std::cerr << "Error: Layer '" << layer.name << "' holds " << Base64::GetDecodedSize( encoded_data ) << " bytes of tile data, expected " << byte_count << "." << std::endl;
+					return false;
+				}
+				decoded.resize( tile_count );
+				if ( !Base64::Decode( encoded_data, reinterpret_cast< uint8_t * >( decoded.data( ) ) ) ) {
+					std::cerr << "Error: Base64 decoding failed for layer '" << layer.name << "'." << std::endl;
+					return false;
+				}
+				return true;
+			}
+
+			const Decompressor decompressor = find_decompressor( *layer.compression );
+			if ( !decompressor ) {
+				std::cerr << "Error: Unsupported compression '" << *layer.compression << "' for layer '" << layer.name << "'." << std::endl;
+				return false;
+			}
+
+			// The compressed bytes need a buffer of their own, reused by every decode on this thread.
+			thread_local std::vector<uint8_t> compressed;
+			compressed.resize( Base64::GetDecodedSize( encoded_data ) );
+			if ( !Base64::Decode( encoded_data, compressed.data( ) ) ) {
+				std::cerr << "Error: Base64 decoding failed for layer '" << layer.name << "'." << std::endl;
+				return false;
+			}
+			// The decompressor fails unless the data fills decoded exactly.
+			decoded.resize( tile_count );
+			if ( !decompressor( compressed.data( ), compressed.size( ), reinterpret_cast< uint8_t * >( decoded.data( ) ), byte_count ) ) {
+				std::cerr << "Error: Failed to decompress " << *layer.compression << " data for layer '" << layer.name << "'." << std::endl;
+				return false;
+			}
+			return true;
+		}
+	}
+
+	void register_decompressor( const std::string &compression, Decompressor decompressor ) {
+		std::vector<DecompressorEntry> &decompressors = get_decompressors( );
+		auto it = std::find_if( decompressors.begin( ), decompressors.end( ), [&] ( const DecompressorEntry &entry ) { return entry.compression == compression; } );
+		if ( it != decompressors.end( ) ) {
+			it->decompressor = decompressor;
+		} else {
+			decompressors.push_back( { compression, decompressor } );
+		}
+	}
+
+	Decompressor find_decompressor( std::string_view compression ) {
+		for ( const DecompressorEntry &entry : get_decompressors( ) ) {
+			if ( entry.compression == compression ) {
+				return entry.decompressor;
+			}
+		}
+		return nullptr;
+	}
+
+	bool decode_tile_data( const Layer &layer, const std::variant<std::vector<uint32_t>, std::string> &data, size_t tile_count, std::vector<uint32_t> &decoded ) {
+		SP_PROFILE_SCOPE( "decode_tile_data" );
+		bool valid;
+		if ( std::holds_alternative<std::vector<uint32_t>>( data ) ) {
+			const std::vector<uint32_t> &gids = std::get<std::vector<uint32_t>>( data );
+			valid = check_gid_count( layer, gids.size( ), tile_count );
+			if ( valid ) {
+				decoded.assign( gids.begin( ), gids.end( ) );
+			}
+		} else {
+			valid = decode_base64_tile_data( layer, std::get<std::string>( data ), tile_count, decoded );
+		}
+		if ( !valid ) {
+			decoded.clear( );
+		}
+		return valid;
+	}
+
+	bool decode_tile_data( const Layer &layer, std::variant<std::vector<uint32_t>, std::string> &&data, size_t tile_count, std::vector<uint32_t> &decoded ) {
+		if ( std::holds_alternative<std::vector<uint32_t>>( data ) ) {
+			std::vector<uint32_t> &gids = std::get<std::vector<uint32_t>>( data );
+			if ( !check_gid_count( layer, gids.size( ), tile_count ) ) {
+				decoded.clear( );
+				return false;
+			}
+			decoded = std::move( gids );
+			return true;
+		}
+		return decode_tile_data( layer, std::as_const( data ), tile_count, decoded );
+	}
+
+	namespace {
+		// Version of the BEVE map cache, older caches are ignored. Bump it with any change to a
+		// cached struct or its meta: an added, removed, renamed or retyped field, or a meta that
+		// reads or writes differently.
+		constexpr uint64_t MAP_CACHE_SCHEMA = 2;
+
+		// A file the cached map was built from and its modification time when it was read.
+		struct MapCacheSource {
+			std::string path{};
+			int64_t timestamp{};
+
+			struct glaze {
+				using T = MapCacheSource;
+				static constexpr auto value = glz::object( "path", &T::path, "timestamp", &T::timestamp );
+			};
+		};
+
+		// What load_map_with_deps writes to the save path: the map with its external tilesets merged,
+		// and the decoded_data of its tile layers, which the Layer meta leaves out.
+		struct MapCache {
+			uint64_t version{};
+			std::vector<MapCacheSource> sources{};		// the map first, then its external tilesets
+			Map map{};
+			std::vector<std::vector<uint32_t>> decoded_layers{};	// in GetAllLayersOfType( "tilelayer", true ) order
+
+			struct glaze {
+				using T = MapCache;
+				static constexpr auto value = glz::object( "version", &T::version, "sources", &T::sources, "map", &T::map, "decoded_layers", &T::decoded_layers );
+			};
+		};
+
+		// An external tileset being loaded by a job, see load_tileset_job.
+		struct TilesetLoad {
+			Tileset *tileset;
+			std::string path;
+			size_t file_size = 0;
+			bool read = false;
+			bool parsed = false;
+		};
+
+		// Reads and parses one external tileset into its slot in the map. Results are reported on
+		// the loading thread once every job is done, so the log stays in tileset order.
+		void load_tileset_job( int, int, uint32_t, void *data ) {
+			SP_PROFILE_SCOPE( "load_tileset" );
+			TilesetLoad &load = *static_cast< TilesetLoad * >( data );
+			auto buffer = fileSystem->ReadFile( load.path );
+			if ( !buffer ) {
+				return;
+			}
+			load.read = true;
+			load.file_size = buffer->size( );
+			auto err = glz::read < glz::opts{ .error_on_unknown_keys = false } > ( *load.tileset, *buffer );
+			load.parsed = !err;
+		}
+
+		// A tile layer decoded by decode_layer_job.
+		struct LayerDecode {
+			Layer *layer;
+			bool decoded = false;
+		};
+
+		// Decodes one layer into its decoded_data. One job per layer, layers differ too much in
+		// size for even ranges to balance. layer.data is consumed: CSV gids are moved over and the
+		// data is reset afterwards, decoded_data is all that is left of it.
+		void decode_layer_job( int, int, uint32_t, void *data ) {
+			LayerDecode &decode = *static_cast< LayerDecode * >( data );
+			Layer &layer = *decode.layer;
+			const size_t tile_count = static_cast< size_t >( std::max( layer.width.value_or( 0 ), 0 ) ) * static_cast< size_t >( std::max( layer.height.value_or( 0 ), 0 ) );
+			decode.decoded = decode_tile_data( layer, std::move( *layer.data ), tile_count, layer.decoded_data );
+			layer.data.reset( );
+		}
+
+		std::string get_map_cache_path( const std::string &map_path ) {
+			return "cache/" + map_path + ".beve";
+		}
+
+		// 0 for files that do not exist, which never match a cached timestamp.
+		int64_t get_source_timestamp( const std::string &path ) {
+			const fs::file_time_type time = fileSystem->GetFileTimestamp( path );
+			return time == FILE_NOT_FOUND_TIMESTAMP ? 0 : static_cast< int64_t >( time.time_since_epoch( ).count( ) );
+		}
+
+		// The cached map if there is one and none of its sources changed since it was written.
+		std::optional<Map> load_map_cache( const std::string &map_path ) {
+			SP_PROFILE_SCOPE( "load_map_cache" );
+			const std::string cache_path = get_map_cache_path( map_path );
+			auto buffer = fileSystem->ReadFile( cache_path );
+			if ( !buffer || buffer->size( ) <= 1 ) {
+				return std::nullopt;
+			}
+
+			MapCache cache;
+			// ReadFile appends a terminating zero, it is not part of the BEVE data.
+			auto err = glz::read_beve( cache, std::string_view( buffer->data( ), buffer->size( ) - 1 ) );
+			if ( err || cache.version != MAP_CACHE_SCHEMA ) {
+				std::cout << "Ignoring map cache '" << cache_path << "', it is unreadable or from another version." << std::endl;
+				return std::nullopt;
+			}
+			if ( cache.sources.empty( ) || cache.sources.front( ).path != map_path ) {
+				return std::nullopt;
+			}
+			for ( const MapCacheSource &source : cache.sources ) {
+				const int64_t timestamp = get_source_timestamp( source.path );
+				if ( timestamp == 0 || timestamp != source.timestamp ) {
+					std::cout << "Map cache '" << cache_path << "' is stale, '" << source.path << "' changed." << std::endl;
+					return std::nullopt;
+				}
+			}
+
+			std::vector<Layer *> tile_layers = cache.map.GetAllLayersOfType( "tilelayer", true );
+			if ( tile_layers.size( ) != cache.decoded_layers.size( ) ) {
+				std::cerr << "Error: Map cache '" << cache_path << "' does not match its map." << std::endl;
+				return std::nullopt;
+			}
+			for ( size_t i = 0; i < tile_layers.size( ); ++i ) {
+				tile_layers[i]->decoded_data = std::move( cache.decoded_layers[i] );
+			}
+
+			std::cout << "Loaded '" << map_path << "' from cache '" << cache_path << "' (" << buffer->size( ) - 1 << " bytes)." << std::endl;
+			return std::move( cache.map );
+		}
 
-			unsigned int have = CHUNK - stream.avail_out;
-			decompressed_data.insert( decompressed_data.end( ), outbuffer, outbuffer + have );
+		// Whether buffer reads back into a cache that serializes to the same bytes. Catches fields
+		// whose meta writes something it cannot read, before a broken cache is ever loaded.
+		bool verify_map_cache( const std::vector<char> &buffer ) {
+			SP_PROFILE_SCOPE( "verify_map_cache" );
+			MapCache check;
+			if ( glz::read_beve( check, buffer ) ) {
+				return false;
+			}
+			std::vector<char> rewritten;
+			return !glz::write_beve( check, rewritten ) && rewritten == buffer;
+		}
 
-		} while ( ret != Z_STREAM_END );
+		// Writes the resolved map to the save path. Failing to is not an error, the next load parses the JSON again.
+		void write_map_cache( const std::string &map_path, Map &map, std::vector<MapCacheSource> sources ) {
+			SP_PROFILE_SCOPE( "write_map_cache" );
+			MapCache cache{ MAP_CACHE_SCHEMA, std::move( sources ), std::move( map ), {} };
+			std::vector<Layer *> tile_layers = cache.map.GetAllLayersOfType( "tilelayer", true );
+			for ( Layer *layer : tile_layers ) {
+				cache.decoded_layers.push_back( std::move( layer->decoded_data ) );
+			}
+
+			const std::string cache_path = get_map_cache_path( map_path );
+			std::vector<char> buffer;
+			if ( glz::write_beve( cache, buffer ) ) {
+				std::cerr << "Warning: Could not serialize map cache for '" << map_path << "'." << std::endl;
+			} else if ( !verify_map_cache( buffer ) ) {
+				std::cerr << "Warning: Map cache for '" << map_path << "' does not read back the way it was written, not caching it." << std::endl;
+			} else if ( fileSystem->WriteFile( cache_path, buffer, "fs_savepath" ) < 0 ) {
+				std::cerr << "Warning: Could not write map cache '" << cache_path << "'." << std::endl;
+			}
 
-		inflateEnd( &stream );
-		return ret == Z_STREAM_END;
+			for ( size_t i = 0; i < tile_layers.size( ); ++i ) {
+				tile_layers[i]->decoded_data = std::move( cache.decoded_layers[i] );
+			}
+			map = std::move( cache.map );
+		}
 	}
 
 	// Loads a Tiled map and recursively resolves its external tilesets
 	std::optional<Tiled::Map> load_map_with_deps( const std::string &map_path ) {
+		SP_PROFILE_SCOPE( "load_map_with_deps" );
+		// --- 0. Use the binary cache while it is newer than every file it was built from ---
+		if ( auto cached = load_map_cache( map_path ) ) {
+			cached->BuildGidIndex( );
+			return cached;
+		}
+
+		// The timestamps are taken before reading, so files changing during the load make the cache stale.
+		std::vector<MapCacheSource> cache_sources = { { map_path, get_source_timestamp( map_path ) } };
+
 		// --- 1. Load the main map file ---
 		size_t map_file_size = 0;		
 		auto map_buffer_data = fileSystem->ReadFile( map_path );
@@ -71,83 +361,123 @@ namespace Tiled {
 
 		std::cout << "Successfully parsed '" << map_path << "'." << std::endl;
 
-		// --- 3. Resolve external tilesets ---
+		// --- 3. Start resolving external tilesets ---
+		// Every external tileset is read and parsed by its own job, straight into its slot of
+		// map.tilesets, so the merged order is the map's no matter which job finishes first.
+		std::vector<TilesetLoad> tileset_loads;
 		for ( auto &tileset : map.tilesets ) {
 			if ( tileset.source ) {
 				std::string tileset_path = *tileset.source;
+				cache_sources.push_back( { tileset_path, get_source_timestamp( tileset_path ) } );
 				std::cout << "> Found external tileset source: '" << *tileset.source << "'. Loading from '" << fileSystem->RelativeToOSPath( tileset_path ) << "'" << std::endl;
-
-				size_t tileset_file_size = 0;
-				
-				auto tileset_buffer_data = fileSystem->ReadFile( tileset_path );
-
-				if ( auto &buffer = tileset_buffer_data ) {
-					// --- Parse the buffer into our struct ---
-					std::cout << "  Successfully loaded '" << tileset_path << "' (" << buffer->size( ) << " bytes)." << std::endl;
-					auto err = glz::read < glz::opts{ .error_on_unknown_keys = false } > ( tileset, *buffer );
-					if ( err ) {
-						std::cerr << "Error: Failed to parse map JSON from '" << map_path << "'." << std::endl;
-						return std::nullopt;
-					}
-				} else {
-					std::cerr << "Error: Could not load map file '" << map_path << "'. SDL_Error: " << SDL_GetError( ) << std::endl;
-					return std::nullopt;
-				}
-
-				std::cout << "  Successfully parsed and merged tileset '" << ( tileset.name ? *tileset.name : "N/A" ) << "'." << std::endl;
+				tileset_loads.push_back( { &tileset, std::move( tileset_path ) } );
 			}
 		}
+		JobCounter tileset_counter;
+		for ( TilesetLoad &load : tileset_loads ) {
+			jobSystem->Submit( load_tileset_job, &load, tileset_counter );
+		}
 
-		// --- 4. Decode layer data ---
-		for ( auto &layerRefPtr : map.GetAllLayersOfType( "tilelayer" ,true) ) {
-			Tiled::Layer &layer = *layerRefPtr;
-			if ( layer.data.has_value( ) ) {
-				//if the variant is a string, its Base64 encoded data?
-				//when it are numbers it is already decoded?
-				if ( std::holds_alternative<std::string>( layer.data.value( ) ) ) {
-					const std::string &encoded_data = std::get<std::string>( layer.data.value( ) );
-
-					SDL_assert( !encoded_data.empty( ) && layer.encoding == "base64" );
+		// --- 4. Decode the tile layers in parallel, next to the tilesets ---
+		// Chunks of infinite maps are decoded on demand, see decode_tile_data.
+		std::vector<LayerDecode> layer_decodes;
+		for ( Layer *layer : map.GetAllLayersOfType( "tilelayer", true ) ) {
+			if ( layer->data.has_value( ) ) {
+				layer_decodes.push_back( { layer } );
+			}
+		}
+		JobCounter layer_counter;
+		for ( LayerDecode &decode : layer_decodes ) {
+			jobSystem->Submit( decode_layer_job, &decode, layer_counter );
+		}
+		jobSystem->Wait( layer_counter );
+		const bool decoded_all = std::all_of( layer_decodes.begin( ), layer_decodes.end( ), [] ( const LayerDecode &decode ) { return decode.decoded; } );
+
+		// Runs the tileset jobs no worker picked up yet.
+		jobSystem->Wait( tileset_counter );
+		bool loaded_all = true;
+		for ( const TilesetLoad &load : tileset_loads ) {
+			if ( !load.read ) {
+				std::cerr << "Error: Could not load tileset file '" << load.path << "'." << std::endl;
+				loaded_all = false;
+			} else if ( !load.parsed ) {
+				std::cerr << "Error: Failed to parse tileset JSON from '" << load.path << "'." << std::endl;
+				loaded_all = false;
+			} else {
+				std::cout << "  Successfully loaded '" << load.path << "' (" << load.file_size << " bytes)." << std::endl;
+				std::cout << "  Successfully parsed and merged tileset '" << ( load.tileset->name ? *load.tileset->name : "N/A" ) << "'." << std::endl;
+			}
+		}
+		if ( !loaded_all ) {
+			return std::nullopt;
+		}
 
-					// 1. Decode Base64 data
-					std::string decoded_b64_str = glz::read_base64( encoded_data );
-					if ( decoded_b64_str.empty( ) && !encoded_data.empty( ) ) {
-						std::cerr << "Error: Base64 decoding failed for layer '" << layer.name << "'." << std::endl;
-						continue;
-					}
+		// --- 5. Cache the result, unless it is broken ---
+		if ( decoded_all ) {
+			write_map_cache( map_path, map, std::move( cache_sources ) );
+		}
 
-					std::vector<unsigned char> current_data( decoded_b64_str.begin( ), decoded_b64_str.end( ) );
-
-					// 2. Decompress if necessary
-					if ( layer.compression && *layer.compression == "zlib" ) {
-						std::vector<unsigned char> decompressed_data;
-						// Pass the decoded base64 string directly to the decompressor
-						if ( decompress_zlib( decoded_b64_str, decompressed_data ) ) {
-							current_data = std::move( decompressed_data );
-						} else {
-							std::cerr << "Error: Failed to decompress zlib data for layer '" << layer.name << "'." << std::endl;
-							continue;
-						}
-					}
+		map.BuildGidIndex( );
 
-					// 3. Safely copy the final byte data into the uint32_t vector
-					if ( current_data.size( ) % sizeof( uint32_t ) != 0 ) {
-						std::cerr << "Error: Decompressed data size is not a multiple of 4 for layer '" << layer.name << "'." << std::endl;
-						continue;
-					}
+		return map;
+	}
 
-					// Reinterpret the data without using memcpy
-					layer.decoded_data.resize( current_data.size( ) / sizeof( uint32_t ) );
-					std::memcpy( layer.decoded_data.data( ), current_data.data( ), current_data.size( ) );
+	void Map::BuildGidIndex( ) {
+		m_gid_index.clear( );
+
+		// Every tileset covers [firstgid, firstgid + count), where count is the tile count or,
+		// for collections of images with gaps in their ids, the highest tile id + 1.
+		std::vector<uint32_t> counts( tilesets.size( ), 0 );
+		uint32_t end_gid = 0;
+		for ( size_t i = 0; i < tilesets.size( ); ++i ) {
+			const Tileset &tileset = tilesets[i];
+			int count = tileset.tilecount.value_or( 0 );
+			if ( count == 0 && tileset.columns.value_or( 0 ) > 0 && tileset.tileheight.value_or( 0 ) > 0 ) {
+				count = *tileset.columns * ( tileset.imageheight.value_or( 0 ) / *tileset.tileheight );
+			}
+			if ( tileset.tiles ) {
+				for ( const auto &tile : *tileset.tiles ) {
+					count = std::max( count, tile.id + 1 );
+				}
+			}
+			counts[i] = static_cast< uint32_t >( std::max( count, 0 ) );
+			end_gid = std::max( end_gid, static_cast< uint32_t >( tileset.firstgid ) + counts[i] );
+		}
 
+		m_gid_index.resize( end_gid );
+		m_render_gid.resize( end_gid );
+		for ( uint32_t gid = 0; gid < end_gid; ++gid ) {
+			m_render_gid[gid] = gid;
+		}
 
-				} else if ( std::holds_alternative<std::vector<uint32_t>>( layer.data.value( ) ) ) {
-					layer.decoded_data = std::get<std::vector<uint32_t>>( layer.data.value( ) );
-				}
+		// Tilesets are sorted by firstgid in the map file, but do not rely on it: walking them in
+		// firstgid order lets later tilesets claim their range, like the largest firstgid <= gid rule.
+		std::vector<size_t> order( tilesets.size( ) );
+		for ( size_t i = 0; i < order.size( ); ++i ) {
+			order[i] = i;
+		}
+		std::sort( order.begin( ), order.end( ), [this] ( size_t a, size_t b ) {
+			return tilesets[a].firstgid < tilesets[b].firstgid;
+		} );
+
+		for ( size_t i : order ) {
+			const uint32_t firstgid = static_cast< uint32_t >( tilesets[i].firstgid );
+			for ( uint32_t local_id = 0; local_id < counts[i]; ++local_id ) {
+				GidEntry &entry = m_gid_index[firstgid + local_id];
+				entry.tileset = static_cast< int32_t >( i );
+				entry.local_id = local_id;
 			}
 		}
+	}
 
-		return map;
+	void Map::UpdateRenderGid( const ActiveAnimationState &state ) {
+		const uint32_t base_gid = state.definition->base_gid;
+		const GidEntry *entry = LookupGid( base_gid );
+		if ( !entry || base_gid >= m_render_gid.size( ) || state.definition->frames.empty( ) ) {
+			return;
+		}
+		const Frame &frame = state.definition->frames[state.current_frame_index];
+		m_render_gid[base_gid] = static_cast< uint32_t >( tilesets[entry->tileset].firstgid + frame.tileid );
 	}
 
 	namespace { // Use an anonymous namespace to keep the helper function private to this file.
@@ -0,0 +1,167 @@
+// Round trip and rejection tests for Base64::Decode, run on every path this CPU supports.
+// Exits with 1 if any check failed.
+
+#include "Base64.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+	constexpr char ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	// Written around the output, a decoder must not touch it.
+	constexpr uint8_t GUARD = 0xA5;
+	constexpr size_t GUARD_SIZE = 64;
+
+	struct PathInfo {
+		Base64::Path path;
+		const char *name;
+	};
+
+	constexpr PathInfo PATHS[] = {
+		{ Base64::Path::Scalar, "scalar" },
+		{ Base64::Path::Sse41, "SSE4.1" },
+		{ Base64::Path::Avx2, "AVX2" },
+		{ Base64::Path::Neon, "NEON" },
+	};
+
+	int failures = 0;
+
+	void Fail( const PathInfo &path, const std::string &what ) {
+		if ( ++failures <= 20 ) {
+			std::cerr << "FAIL [" << path.name << "] " << what << std::endl;
+		}
+	}
+
+	std::string Encode( const std::vector<uint8_t> &bytes, bool padded ) {
+		std::string encoded;
+		size_t i = 0;
+		for ( ; i + 3 <= bytes.size( ); i += 3 ) {
+			const uint32_t bits = ( uint32_t( bytes[i] ) << 16 ) | ( uint32_t( bytes[i + 1] ) << 8 ) | bytes[i + 2];
+			encoded += ALPHABET[( bits >> 18 ) & 63];
+			encoded += ALPHABET[( bits >> 12 ) & 63];
+			encoded += ALPHABET[( bits >> 6 ) & 63];
+			encoded += ALPHABET[bits & 63];
+		}
+		if ( bytes.size( ) - i == 1 ) {
+			const uint32_t bits = uint32_t( bytes[i] ) << 16;
+			encoded += ALPHABET[( bits >> 18 ) & 63];
+			encoded += ALPHABET[( bits >> 12 ) & 63];
+			encoded += padded ? "==" : "";
+		} else if ( bytes.size( ) - i == 2 ) {
+			const uint32_t bits = ( uint32_t( bytes[i] ) << 16 ) | ( uint32_t( bytes[i + 1] ) << 8 );
+			encoded += ALPHABET[( bits >> 18 ) & 63];
+			encoded += ALPHABET[( bits >> 12 ) & 63];
+			encoded += ALPHABET[( bits >> 6 ) & 63];
+			encoded += padded ? "=" : "";
+		}
+		return encoded;
+	}
+
+	// Independent of the decoder under test: strips trailing '=', then reads 6 bits per character.
+	std::optional<std::vector<uint8_t>> ReferenceDecode( const std::string &encoded ) {
+		size_t length = encoded.size( );
+		while ( length > 0 && encoded[length - 1] == '=' ) {
+			--length;
+		}
+		if ( length % 4 == 1 ) {
+			return std::nullopt;
+		}
+		std::vector<uint8_t> bytes;
+		uint32_t bits = 0;
+		int bitCount = 0;
+		for ( size_t i = 0; i < length; ++i ) {
+			const char *found = std::strchr( ALPHABET, encoded[i] );
+			if ( encoded[i] == '\0' || !found ) {
+				return std::nullopt;
+			}
+			bits = ( bits << 6 ) | static_cast< uint32_t >( found - ALPHABET );
+			bitCount += 6;
+			if ( bitCount >= 8 ) {
+				bitCount -= 8;
+				bytes.push_back( static_cast< uint8_t >( bits >> bitCount ) );
+			}
+		}
+		return bytes;
+	}
+
+	// Decodes into a guarded buffer and checks result, output and guards against expected.
+	void Check( const PathInfo &path, const std::string &encoded, const std::optional<std::vector<uint8_t>> &expected, const std::string &what ) {
+		const size_t size = Base64::GetDecodedSize( encoded );
+		std::vector<uint8_t> buffer( size + 2 * GUARD_SIZE, GUARD );
+		uint8_t *out = buffer.data( ) + GUARD_SIZE;
+		const bool decoded = Base64::Decode( encoded, out, path.path );
+
+		if ( decoded != expected.has_value( ) ) {
+			Fail( path, what + ": returned " + ( decoded ? "true" : "false" ) );
+			return;
+		}
+		if ( expected && ( expected->size( ) != size || !std::equal( expected->begin( ), expected->end( ), out ) ) ) {
+			Fail( path, what + ": wrong output" );
+		}
+		for ( size_t i = 0; i < GUARD_SIZE; ++i ) {
+			if ( buffer[i] != GUARD || buffer[GUARD_SIZE + size + i] != GUARD ) {
+				Fail( path, what + ": wrote outside the output" );
+				break;
+			}
+		}
+	}
+
+	std::vector<uint8_t> RandomBytes( std::mt19937 &random, size_t count ) {
+		std::vector<uint8_t> bytes( count );
+		for ( uint8_t &byte : bytes ) {
+			byte = static_cast< uint8_t >( random( ) );
+		}
+		return bytes;
+	}
+
+	void TestRoundTrips( const PathInfo &path ) {
+		std::mt19937 random( 1 );
+		for ( size_t count = 0; count <= 1000; ++count ) {
+			const std::vector<uint8_t> bytes = RandomBytes( random, count );
+			Check( path, Encode( bytes, true ), bytes, "padded round trip of " + std::to_string( count ) + " bytes" );
+			Check( path, Encode( bytes, false ), bytes, "unpadded round trip of " + std::to_string( count ) + " bytes" );
+		}
+
+		// Large layers, one a whole number of vector blocks and one with a tail behind them.
+		for ( size_t count : { size_t( 4 ) << 20, ( size_t( 4 ) << 20 ) + 7 } ) {
+			const std::vector<uint8_t> bytes = RandomBytes( random, count );
+			Check( path, Encode( bytes, true ), bytes, "round trip of " + std::to_string( count ) + " bytes" );
+		}
+	}
+
+	// Every byte value at every position of inputs spanning several vector blocks and the tail,
+	// the decoder has to agree with the reference on acceptance and output.
+	void TestEveryByte( const PathInfo &path ) {
+		std::mt19937 random( 2 );
+		for ( size_t count : { size_t( 96 ), size_t( 97 ), size_t( 98 ) } ) {
+			const std::string valid = Encode( RandomBytes( random, count ), false );
+			for ( size_t position = 0; position < valid.size( ); ++position ) {
+				for ( int value = 0; value < 256; ++value ) {
+					std::string encoded = valid;
+					encoded[position] = static_cast< char >( value );
+					Check( path, encoded, ReferenceDecode( encoded ), "byte " + std::to_string( value ) + " at " + std::to_string( position ) + " of " + std::to_string( valid.size( ) ) );
+				}
+			}
+		}
+	}
+}
+
+int main( ) {
+	for ( const PathInfo &path : PATHS ) {
+		if ( !Base64::IsSupported( path.path ) ) {
+			std::cout << "Skipping " << path.name << ", not supported here." << std::endl;
+			continue;
+		}
+		const int before = failures;
+		TestRoundTrips( path );
+		TestEveryByte( path );
+		std::cout << path.name << ": " << ( failures == before ? "passed" : "FAILED" ) << std::endl;
+	}
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,119 @@
+// Loads a map through the BEVE map cache and checks it against a fresh parse of the JSON,
+// decoded tile layers and merged external tilesets included. Works on a copy of the content.
+// Usage: map_cache_test <content directory> <scratch directory>
+
+#include "tiled_data.h"
+#include "FileSystem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace {
+	const std::string MAP_PATH = "tileMaps/main_menu.json";
+	const std::string TILESET_PATH = "tileSets/env_1_1.json";
+
+	int failures = 0;
+
+	void Check( bool condition, const std::string &what ) {
+		if ( !condition ) {
+			++failures;
+			std::cerr << "FAIL " << what << std::endl;
+		}
+	}
+
+	// Everything the metas write, plus the decoded layers and the gid index they leave out.
+	void CheckSame( Tiled::Map &expected, Tiled::Map &actual, const std::string &what ) {
+		std::string expectedJson, actualJson;
+		Check( !glz::write_json( expected, expectedJson ) && !glz::write_json( actual, actualJson ), what + ": writing JSON" );
+		Check( expectedJson == actualJson, what + ": maps differ" );
+		Check( !expected.tilesets.empty( ) && expected.tilesets.back( ).name.has_value( ), what + ": external tilesets not merged" );
+
+		const std::vector<Tiled::Layer *> expectedLayers = expected.GetAllLayersOfType( "tilelayer", true );
+		const std::vector<Tiled::Layer *> actualLayers = actual.GetAllLayersOfType( "tilelayer", true );
+		Check( !expectedLayers.empty( ) && expectedLayers.size( ) == actualLayers.size( ), what + ": tile layer count differs" );
+		for ( size_t i = 0; i < std::min( expectedLayers.size( ), actualLayers.size( ) ); ++i ) {
+			Check( !expectedLayers[i]->decoded_data.empty( ) && expectedLayers[i]->decoded_data == actualLayers[i]->decoded_data,
+				what + ": decoded data of layer '" + expectedLayers[i]->name + "' differs" );
+		}
+
+		bool sameIndex = expected.m_gid_index.size( ) == actual.m_gid_index.size( );
+		for ( size_t gid = 0; sameIndex && gid < expected.m_gid_index.size( ); ++gid ) {
+			sameIndex = expected.m_gid_index[gid].tileset == actual.m_gid_index[gid].tileset && expected.m_gid_index[gid].local_id == actual.m_gid_index[gid].local_id;
+		}
+		Check( sameIndex, what + ": gid index differs" );
+	}
+
+	// Replaces a file's contents but keeps its modification time, so the cache still trusts it.
+	void OverwriteKeepingTime( const fs::path &path, const std::string &contents ) {
+		const fs::file_time_type time = fs::last_write_time( path );
+		std::ofstream( path, std::ios::binary | std::ios::trunc ) << contents;
+		fs::last_write_time( path, time );
+	}
+}
+
+int main( int argc, char **argv ) {
+	if ( argc != 3 ) {
+		std::cerr << "Usage: map_cache_test <content directory> <scratch directory>" << std::endl;
+		return 1;
+	}
+	const fs::path content = argv[1];
+	const fs::path scratch = argv[2];
+	fs::remove_all( scratch );
+	fs::create_directories( scratch / "base" );
+	fs::copy( content / "base" / "tileMaps", scratch / "base" / "tileMaps", fs::copy_options::recursive );
+	fs::copy( content / "base" / "tileSets", scratch / "base" / "tileSets", fs::copy_options::recursive );
+	fileSystem->Init( scratch, scratch / "save" );
+
+	const fs::path mapFile = scratch / "base" / MAP_PATH;
+	const fs::path cacheFile = scratch / "save" / "base" / "cache" / ( MAP_PATH + ".beve" );
+
+	// A fresh parse writes the cache.
+	std::optional<Tiled::Map> parsed = Tiled::load_map_with_deps( MAP_PATH );
+	Check( parsed.has_value( ), "parsing the map" );
+	Check( fs::exists( cacheFile ), "writing the cache" );
+	if ( !parsed ) {
+		return 1;
+	}
+
+	// With the JSON broken behind the cache's back, only the cache can produce the map.
+	OverwriteKeepingTime( mapFile, "not a map" );
+	std::optional<Tiled::Map> cached = Tiled::load_map_with_deps( MAP_PATH );
+	Check( cached.has_value( ), "loading from the cache" );
+	if ( cached ) {
+		CheckSame( *parsed, *cached, "cached" );
+	}
+
+	// A truncated cache is rejected, which leaves the broken JSON.
+	std::string cacheBytes;
+	{
+		std::ifstream file( cacheFile, std::ios::binary );
+		cacheBytes.assign( std::istreambuf_iterator<char>( file ), std::istreambuf_iterator<char>( ) );
+	}
+	OverwriteKeepingTime( cacheFile, cacheBytes.substr( 0, cacheBytes.size( ) / 2 ) );
+	Check( !Tiled::load_map_with_deps( MAP_PATH ), "rejecting a truncated cache" );
+
+	// A newer tileset makes an intact cache stale.
+	OverwriteKeepingTime( cacheFile, cacheBytes );
+	fs::last_write_time( scratch / "base" / TILESET_PATH, fs::last_write_time( scratch / "base" / TILESET_PATH ) + std::chrono::seconds( 10 ) );
+	Check( !Tiled::load_map_with_deps( MAP_PATH ), "rejecting a stale cache" );
+
+	// Restoring the JSON parses it again and rewrites the cache, which then loads the same map.
+	fs::copy_file( content / "base" / MAP_PATH, mapFile, fs::copy_options::overwrite_existing );
+	std::optional<Tiled::Map> reparsed = Tiled::load_map_with_deps( MAP_PATH );
+	Check( reparsed.has_value( ), "parsing the restored map" );
+	std::optional<Tiled::Map> recached = Tiled::load_map_with_deps( MAP_PATH );
+	Check( recached.has_value( ), "loading the rewritten cache" );
+	if ( reparsed && recached ) {
+		CheckSame( *parsed, *reparsed, "reparsed" );
+		CheckSame( *parsed, *recached, "recached" );
+	}
+
+	std::cout << ( failures == 0 ? "Map cache: passed" : "Map cache: FAILED" ) << std::endl;
+	return failures == 0 ? 0 : 1;
+}